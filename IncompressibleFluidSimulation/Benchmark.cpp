@@ -0,0 +1,393 @@
+// Times the individual FluidBox kernels at several grid sizes and writes the results as JSON.
+// usage: FluidSimBenchmark [--sizes 128,256,...] [--state file.ckpt] [--pressure relax,mg,pcg,fft] [--threads #] [--min-time seconds] [--out file.json]
+// --state starts from a checkpoint (at its own size) instead of the seeded state, plus the seeded tracers if it has none
+//
+// Every kernel starts each repetition from the same state (restored outside the timed region) so runs can be compared
+// across commits. Bandwidth is worked out from the memory each kernel has to stream per cell, kernels whose traffic
+// depends on the data (pressure solves other than relaxation, tracers, brush strokes) report it as null.
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
+
+#include <glm/glm.hpp>
+
+#include "Checkpoint.h"
+#include "FluidBox.h"
+#include "DensityPacking.h"
+
+using namespace std;
+
+struct BenchmarkResult {
+	string kernel;
+	int size;
+
+	// what one unit of work is and how many of them each repetition does
+	string unit;
+	double units;
+
+	// bytes that have to move per unit, 0 when there is no fixed figure
+	double bytesPerUnit;
+
+	vector<double> seconds;
+};
+
+static const float PI = 3.14159265358979f;
+
+double minTime = 0.25;
+int minReps = 3;
+int maxReps = 1000;
+
+vector<BenchmarkResult> results;
+
+vector<int> parseList(string text) {
+	vector<int> list;
+	stringstream stream(text);
+	string item;
+	while (getline(stream, item, ',')) {
+		list.push_back(stoi(item));
+	}
+	return list;
+}
+
+vector<string> parseNames(string text) {
+	vector<string> list;
+	stringstream stream(text);
+	string item;
+	while (getline(stream, item, ',')) {
+		list.push_back(item);
+	}
+	return list;
+}
+
+// one tracer every 8 cells, or one in the middle of a grid too small for that
+void seedTracers(FluidBox &fluid) {
+	int n = fluid.size;
+
+	for (int y = 4; y < n - 4; y += 8) {
+		for (int x = 4; x < n - 4; x += 8) {
+			fluid.addTracer(glm::vec2(x, y), glm::vec3(255));
+		}
+	}
+
+	if (fluid.tracers.empty()) {
+		fluid.addTracer(glm::vec2(n / 2, n / 2), glm::vec3(255));
+	}
+}
+
+// smooth swirling velocity and banded density so the kernels see realistic, non zero data
+void seedState(FluidBox &fluid) {
+	int n = fluid.size;
+
+	for (int y = 0; y < n; y++) {
+		for (int x = 0; x < n; x++) {
+			float u = float(x) / n;
+			float v = float(y) / n;
+
+			fluid.velocity->getXList()[y][x] = 0.05f * sinf(2 * PI * v) * cosf(PI * u);
+			fluid.velocity->getYList()[y][x] = -0.05f * sinf(2 * PI * u) * cosf(PI * v);
+			fluid.velocityPrev->getXList()[y][x] = fluid.velocity->getXList()[y][x];
+			fluid.velocityPrev->getYList()[y][x] = fluid.velocity->getYList()[y][x];
+
+			for (int c = 0; c < 3; c++) {
+				float value = 127.5f + 127.5f * sinf(2 * PI * (u * (c + 1) + v * (3 - c)));
+				fluid.density[c][y][x] = value;
+				fluid.prevDensity[c][y][x] = value;
+			}
+		}
+	}
+
+	seedTracers(fluid);
+}
+
+// repeats body (after reset, which is not timed) until minTime has passed and at least minReps have run
+void runBenchmark(string kernel, int size, string unit, double units, double bytesPerUnit, const function<void()> &reset, const function<void()> &body) {
+	BenchmarkResult result;
+	result.kernel = kernel;
+	result.size = size;
+	result.unit = unit;
+	result.units = units;
+	result.bytesPerUnit = bytesPerUnit;
+
+	// warm up caches, lazily built solver data and the pool
+	reset();
+	body();
+
+	double total = 0;
+	while ((total < minTime || result.seconds.size() < minReps) && result.seconds.size() < maxReps) {
+		reset();
+
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		body();
+		chrono::steady_clock::time_point end = chrono::steady_clock::now();
+
+		double seconds = chrono::duration<double>(end - start).count();
+		result.seconds.push_back(seconds);
+		total += seconds;
+	}
+
+	results.push_back(result);
+
+	cerr << "  " << kernel << ": " << 1e9 * total / result.seconds.size() / units << " ns/" << unit << endl;
+}
+
+void benchmarkSize(int size, string statePath, vector<string> &pressureSolvers, int threads) {
+	// same settings the viewer starts with
+	FluidBox fluid(size, 0.0f, 0.0000001f, 0.4f);
+	fluid.setThreadCount(threads);
+
+	if (statePath != "") {
+		string error;
+		if (!loadCheckpoint(fluid, statePath, error)) {
+			throw runtime_error(error);
+		}
+		size = fluid.size;
+
+		// a checkpoint saved without tracers would leave updateTracers nothing to time
+		if (fluid.tracers.empty()) {
+			seedTracers(fluid);
+		}
+	}
+	else {
+		seedState(fluid);
+	}
+
+	cerr << "size " << size << endl;
+
+	Field2D& vPrevX = fluid.velocityPrev->getXList();
+	Field2D& vPrevY = fluid.velocityPrev->getYList();
+	Field2D& vX = fluid.velocity->getXList();
+	Field2D& vY = fluid.velocity->getYList();
+
+	Field2D savedVPrevX = vPrevX;
+	Field2D savedVX = vX;
+	Field2D savedVY = vY;
+	Field2D savedPressure = fluid.pressure;
+	vector<Field2D> savedDensity = fluid.density;
+	vector<Tracer> savedTracers = fluid.tracers;
+
+	double cells = double(size) * size;
+
+	// gauss seidel reads v and vPrev and writes v every iteration
+	runBenchmark("diffuse", size, "cell", cells, 12.0 * fluid.divIter,
+		[&] { vPrevX = savedVPrevX; },
+		[&] { fluid.diffuse(vPrevX, vX, 1); });
+
+	for (int i = 0; i < pressureSolvers.size(); i++) {
+		string name = pressureSolvers[i];
+		double bytes = 0;
+
+		if (name == "relax") {
+			fluid.pressureSolver = PressureSolver::RELAXATION;
+			// divergence pass + divIter relaxation sweeps + gradient pass
+			bytes = 12.0 + 12.0 * fluid.divIter + 20.0;
+		}
+		else if (name == "mg") {
+			fluid.pressureSolver = PressureSolver::MULTIGRID;
+		}
+		else if (name == "pcg") {
+			fluid.pressureSolver = PressureSolver::CONJUGATE_GRADIENT;
+		}
+		else if (name == "fft") {
+			fluid.pressureSolver = PressureSolver::SPECTRAL;
+		}
+		else {
+			throw invalid_argument("unknown pressure solver " + name);
+		}
+
+		// starts cold every time, a warm start would make the repeats after the first one almost free
+		runBenchmark("project_" + name, size, "cell", cells, bytes,
+			[&] { vX = savedVX; vY = savedVY; fluid.pressure = savedPressure; },
+			[&] { fluid.project(vX, vY, vPrevY); });
+	}
+	fluid.pressureSolver = PressureSolver::RELAXATION;
+
+	// reads the velocity and for each of the three channels gathers d0 and writes d
+	runBenchmark("advect", size, "cell", cells, 8.0 + 3 * 8.0,
+		[&] {},
+		[&] {
+			vector<AdvectedField> fields;
+			for (int c = 0; c < 3; c++) {
+				fields.push_back(AdvectedField(fluid.density[c], fluid.prevDensity[c], 0));
+			}
+			fluid.advectFields(vX, vY, fields);
+		});
+
+	runBenchmark("updateTracers", size, "tracer", double(savedTracers.size()), 0,
+		[&] { fluid.tracers = savedTracers; },
+		[&] { fluid.updateTracers(); });
+
+	// read and write all three channels
+	runBenchmark("fadeDensity", size, "cell", cells, 24.0,
+		[&] { fluid.density = savedDensity; },
+		[&] { fluid.fadeDensity(0.05f, 0, 255); });
+
+	// the viewer's default brush, repeated so one repetition is long enough to time
+	int brushSize = 10;
+	int strokes = 64;
+	int brushCells = 0;
+	for (int y = -brushSize; y < brushSize; y++) {
+		for (int x = -brushSize; x < brushSize; x++) {
+			if (glm::length(glm::vec2(x, y)) <= brushSize) {
+				brushCells++;
+			}
+		}
+	}
+
+	runBenchmark("splat", size, "brush cell", double(strokes) * brushCells, 0,
+		[&] {},
+		[&] {
+			for (int i = 0; i < strokes; i++) {
+				fluid.splat(glm::vec2(size / 2.0f, size / 2.0f), glm::vec2(1, 0), brushSize, 20.0f, 0.05f, glm::vec3(255, 128, 30));
+			}
+		});
+
+	// reads three channels and writes three of the transfer format per cell
+	vector<float> texels(size_t(size) * size * DENSITY_TEXEL_FLOATS);
+	for (TexelFormat format : { FLOAT_TEXELS, HALF_TEXELS, SRGB8_TEXELS }) {
+		string name = format == FLOAT_TEXELS ? "updateData" : string("updateData_") + texelFormatName(format);
+		runBenchmark(name, size, "cell", cells, 12.0 + DENSITY_TEXEL_FLOATS * texelChannelBytes(format),
+			[&] {},
+			[&] { packDensityTexels(fluid, format, texels.data()); });
+	}
+}
+
+void writeNumber(ostream &out, double value) {
+	if (std::isfinite(value)) {
+		out << value;
+	}
+	else {
+		out << "null";
+	}
+}
+
+void writeJSON(ostream &out, int threads, string simd) {
+	out.precision(6);
+
+	out << "{\n";
+	out << "  \"threads\": " << threads << ",\n";
+	out << "  \"simd\": \"" << simd << "\",\n";
+	out << "  \"results\": [\n";
+
+	for (int i = 0; i < results.size(); i++) {
+		BenchmarkResult &result = results[i];
+
+		// per unit statistics over the repetitions
+		vector<double> perUnit;
+		double sum = 0;
+		for (int r = 0; r < result.seconds.size(); r++) {
+			perUnit.push_back(1e9 * result.seconds[r] / result.units);
+			sum += perUnit.back();
+		}
+		sort(perUnit.begin(), perUnit.end());
+
+		double mean = sum / perUnit.size();
+		double variance = 0;
+		for (int r = 0; r < perUnit.size(); r++) {
+			variance += (perUnit[r] - mean) * (perUnit[r] - mean);
+		}
+		variance /= max(1, int(perUnit.size()) - 1);
+		double stddev = sqrt(variance);
+
+		// bytes per nanosecond is GB/s
+		double bandwidth = result.bytesPerUnit > 0 ? result.bytesPerUnit / mean : NAN;
+
+		out << "    {\"kernel\": \"" << result.kernel << "\", \"size\": " << result.size;
+		out << ", \"unit\": \"" << result.unit << "\", \"units\": " << (long long)result.units;
+		out << ", \"reps\": " << perUnit.size();
+		out << ", \"ns_per_unit\": {\"mean\": ";
+		writeNumber(out, mean);
+		out << ", \"median\": ";
+		writeNumber(out, perUnit[perUnit.size() / 2]);
+		out << ", \"min\": ";
+		writeNumber(out, perUnit.front());
+		out << ", \"max\": ";
+		writeNumber(out, perUnit.back());
+		out << ", \"stddev\": ";
+		writeNumber(out, stddev);
+		out << ", \"variance\": ";
+		writeNumber(out, variance);
+		out << "}, \"gb_per_s\": ";
+		writeNumber(out, bandwidth);
+		out << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+	}
+
+	out << "  ]\n";
+	out << "}\n";
+}
+
+int main(int argc, char** argv) {
+	vector<int> sizes = { 128, 256, 512, 1024, 2048, 4096 };
+	vector<string> pressureSolvers = { "relax" };
+	int threads = 0;
+	string outPath = "";
+	string statePath = "";
+
+	try {
+		for (int i = 1; i < argc; i++) {
+			string arg = argv[i];
+			bool hasValue = i + 1 < argc;
+
+			if (arg == "--sizes" && hasValue) {
+				sizes = parseList(argv[++i]);
+			}
+			else if (arg == "--state" && hasValue) {
+				statePath = argv[++i];
+			}
+			else if (arg == "--pressure" && hasValue) {
+				pressureSolvers = parseNames(argv[++i]);
+			}
+			else if (arg == "--threads" && hasValue) {
+				threads = max(0, stoi(argv[++i]));
+			}
+			else if (arg == "--min-time" && hasValue) {
+				minTime = stod(argv[++i]);
+			}
+			else if (arg == "--out" && hasValue) {
+				outPath = argv[++i];
+			}
+			else {
+				cout << "usage: FluidSimBenchmark [--sizes 128,256,...] [--state file.ckpt] [--pressure relax,mg,pcg,fft] [--threads #] [--min-time seconds] [--out file.json]" << endl;
+				return arg == "--help" || arg == "-h" ? 0 : 1;
+			}
+		}
+
+		if (statePath != "") {
+			benchmarkSize(0, statePath, pressureSolvers, threads);
+		}
+		else {
+			for (int i = 0; i < sizes.size(); i++) {
+				benchmarkSize(max(8, sizes[i]), "", pressureSolvers, threads);
+			}
+		}
+	}
+	catch (std::exception &err) {
+		cerr << err.what() << endl;
+		return 1;
+	}
+
+	int threadCount = threads > 0 ? threads : max(1, int(std::thread::hardware_concurrency()));
+	string simd = StencilKernels::name(StencilKernels::detect());
+
+	if (outPath == "") {
+		writeJSON(cout, threadCount, simd);
+	}
+	else {
+		ofstream file(outPath);
+		if (!file) {
+			cerr << "Could not write " << outPath << endl;
+			return 1;
+		}
+		writeJSON(file, threadCount, simd);
+	}
+
+	return 0;
+}
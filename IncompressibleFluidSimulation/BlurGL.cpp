@@ -1,5 +1,8 @@
 #include "BlurGL.h"
 
+#include <algorithm>
+#include <cmath>
+
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
@@ -9,15 +12,42 @@
 
 #include "RenderObject.h"
 #include "Quad.h"
+#include "TraceRecorder.h"
+
+using namespace std;
+
+// spread in pixels of one pass of the original 11 tap kernel
+static const float GAUSSIAN_SIGMA = 1.04f;
+
+// how many sigmas out the kernel reaches before the weights are too small to see
+static const float KERNEL_EXTENT = 3.0f;
+
+// measured by pushing an impulse through the dual filter on the cpu: with n levels and a tap offset of o the result
+// spreads about 2^(n - 1) * (DUAL_SIGMA_BASE + DUAL_SIGMA_PER_OFFSET * o) pixels, offsets outside the range start to
+// show the taps as separate copies
+static const float DUAL_SIGMA_BASE = 0.5f;
+static const float DUAL_SIGMA_PER_OFFSET = 0.9f;
+static const float DUAL_MIN_OFFSET = 0.5f;
+static const float DUAL_MAX_OFFSET = 1.5f;
 
 BlurGL::BlurGL()
 {
+	format = GL_RGB;
 	shader = Shader("resources/shaders/gausian_blur.vs", "resources/shaders/gausian_blur.fs");
+	downsampleShader = Shader("resources/shaders/render_quad.vs", "resources/shaders/dual_downsample.fs");
+	upsampleShader = Shader("resources/shaders/render_quad.vs", "resources/shaders/dual_upsample.fs");
+	mode = GAUSSIAN_BLUR;
+	kernelSigma = -1;
 }
 
 BlurGL::BlurGL(int width, int height)
 {
+	format = GL_RGB;
 	shader = Shader("resources/shaders/gausian_blur.vs", "resources/shaders/gausian_blur.fs");
+	downsampleShader = Shader("resources/shaders/render_quad.vs", "resources/shaders/dual_downsample.fs");
+	upsampleShader = Shader("resources/shaders/render_quad.vs", "resources/shaders/dual_upsample.fs");
+	mode = GAUSSIAN_BLUR;
+	kernelSigma = -1;
 
 	setup(width, height);
 }
@@ -40,11 +70,10 @@ void BlurGL::setup(int width, int height) {
 	glGenTextures(1, &outX);
 	glBindTexture(GL_TEXTURE_2D, outX);
 
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_FLOAT, NULL);
-	//glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	//glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, GL_RGB, GL_FLOAT, NULL);
+	// the gaussian reads two texels per fetch by sampling between them
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 	//glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
 	//glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
@@ -64,11 +93,10 @@ void BlurGL::setup(int width, int height) {
 	glGenTextures(1, &outY);
 	glBindTexture(GL_TEXTURE_2D, outY);
 
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_FLOAT, NULL);
-	//glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	//glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, GL_RGB, GL_FLOAT, NULL);
+	// the gaussian reads two texels per fetch by sampling between them
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 	//glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
 	//glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
@@ -79,6 +107,57 @@ void BlurGL::setup(int width, int height) {
 	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, outY, 0);
 	glEnable(GL_DEPTH_TEST);
 	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	setupLevels();
+}
+
+void BlurGL::setupLevels() {
+	glDeleteFramebuffers((GLsizei)levelFBOs.size(), levelFBOs.data());
+	glDeleteTextures((GLsizei)levelTextures.size(), levelTextures.data());
+
+	levelFBOs.clear();
+	levelTextures.clear();
+	levelWidths.clear();
+	levelHeights.clear();
+
+	int levelWidth = width / 2;
+	int levelHeight = height / 2;
+	while ((int)levelFBOs.size() < MAX_LEVELS && levelWidth > 0 && levelHeight > 0) {
+		unsigned int fbo;
+		unsigned int texture;
+
+		glGenTextures(1, &texture);
+		glBindTexture(GL_TEXTURE_2D, texture);
+
+		// the taps land between texels so the hardware blends four of them per fetch
+		glTexImage2D(GL_TEXTURE_2D, 0, format, levelWidth, levelHeight, 0, GL_RGB, GL_FLOAT, NULL);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+		glGenFramebuffers(1, &fbo);
+		glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+		levelFBOs.push_back(fbo);
+		levelTextures.push_back(texture);
+		levelWidths.push_back(levelWidth);
+		levelHeights.push_back(levelHeight);
+
+		levelWidth /= 2;
+		levelHeight /= 2;
+	}
+}
+
+void BlurGL::setFormat(unsigned int format) {
+	if (format == this->format) {
+		return;
+	}
+
+	this->format = format;
+	setup(width, height);
 }
 
 unsigned int &BlurGL::process(int width, int height, unsigned int &inputTex,int blurIterations)
@@ -93,41 +172,156 @@ unsigned int &BlurGL::process(int width, int height, unsigned int &inputTex,int
 		setup(width, height);
 	}
 
-	//enter the gausian blur buffer phase
-	//render the current information to a quad and then send that data to the shader
-	//x axis
-	glBindFramebuffer(GL_FRAMEBUFFER, FBOX);
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	if (mode == DUAL_BLUR) {
+		return processDual(inputTex, blurIterations);
+	}
 
-	shader.use();
-	shader.setInt("stage", 0);
-	shader.setFloat("textureWidth", width);
-	shader.setFloat("textureHeight", height);
+	// stacking n gaussians gives one sqrt(n) times as wide, so a single pass covers every iteration
+	float sigma = GAUSSIAN_SIGMA * sqrt((float)blurIterations);
 
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, inputTex);
+	// past what one kernel can reach split it into equal passes, which add up the same way
+	int passes = 1;
+	while (ceil(KERNEL_EXTENT * sigma / sqrt((float)passes)) > 2 * MAX_TAP_PAIRS) {
+		passes++;
+	}
 
-	Quad::render();
+	setKernel(sigma / sqrt((float)passes));
 
-	//y axis
-	glBindFramebuffer(GL_FRAMEBUFFER, FBOY);
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	unsigned int* input = &inputTex;
+	for (int i = 0; i < passes; i++) {
+		TraceScope trace("blur pass");
 
-	shader.use();
-	shader.setInt("stage", 1);
-	shader.setFloat("textureWidth", width);
-	shader.setFloat("textureHeight", height);
+		//x axis
+		glBindFramebuffer(GL_FRAMEBUFFER, FBOX);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, outX);
+		shader.use();
+		shader.setVec2("texelStep", 1.0f / width, 0.0f);
+
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, *input);
+
+		Quad::render();
+
+		//y axis
+		glBindFramebuffer(GL_FRAMEBUFFER, FBOY);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-	Quad::render();
+		shader.setVec2("texelStep", 0.0f, 1.0f / height);
+
+		glBindTexture(GL_TEXTURE_2D, outX);
+
+		Quad::render();
+
+		input = &outY;
+	}
 
 	// reset buffer
 	glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
-	// process more iterations if specified (if blurIterations - 1 is 0 or less then it will just return outY)
-	return process(this->width, this->height, outY, blurIterations - 1);
+	return outY;
+}
+
+void BlurGL::setKernel(float sigma) {
+	if (sigma == kernelSigma) {
+		return;
+	}
+
+	kernelSigma = sigma;
+
+	// sampled gaussian out to the extent, one extra zero so the last pair is always whole
+	int radius = (int)ceil(KERNEL_EXTENT * sigma);
+	vector<float> weights(radius + 2, 0.0f);
+	float total = 0;
+	for (int i = 0; i <= radius; i++) {
+		weights[i] = exp(-(i * i) / (2 * sigma * sigma));
+		total += i == 0 ? weights[i] : 2 * weights[i];
+	}
+	for (float &weight : weights) {
+		weight /= total;
+	}
+
+	// a fetch placed between texels i and i + 1 at the ratio of their weights returns their weighted sum
+	tapOffsets = { 0.0f };
+	tapWeights = { weights[0] };
+	for (int i = 1; i <= radius; i += 2) {
+		float weight = weights[i] + weights[i + 1];
+		tapOffsets.push_back((i * weights[i] + (i + 1) * weights[i + 1]) / weight);
+		tapWeights.push_back(weight);
+	}
+
+	shader.use();
+	glUniform1i(glGetUniformLocation(shader.ID, "tapCount"), (GLint)tapOffsets.size());
+	glUniform1fv(glGetUniformLocation(shader.ID, "tapOffsets"), (GLsizei)tapOffsets.size(), tapOffsets.data());
+	glUniform1fv(glGetUniformLocation(shader.ID, "tapWeights"), (GLsizei)tapWeights.size(), tapWeights.data());
+}
+
+unsigned int &BlurGL::processDual(unsigned int &inputTex, int blurIterations) {
+	// too small a window to halve, nothing to blur into
+	if (levelFBOs.empty()) {
+		return inputTex;
+	}
+
+	// match the spread of blurIterations gaussian passes, which grows with the square root of the passes
+	float sigma = GAUSSIAN_SIGMA * sqrt((float)blurIterations);
+
+	// the fewest levels that reach it without spreading the taps too far
+	int levels = 1;
+	float scale = 1;
+	while (levels < (int)levelFBOs.size() && scale * (DUAL_SIGMA_BASE + DUAL_SIGMA_PER_OFFSET * DUAL_MAX_OFFSET) < sigma) {
+		levels++;
+		scale *= 2;
+	}
+
+	float offset = (sigma / scale - DUAL_SIGMA_BASE) / DUAL_SIGMA_PER_OFFSET;
+	offset = max(DUAL_MIN_OFFSET, min(DUAL_MAX_OFFSET, offset));
+
+	{
+		TraceScope trace("blur downsample");
+
+		downsampleShader.use();
+		downsampleShader.setInt("tex", 0);
+		downsampleShader.setFloat("offset", offset);
+		glActiveTexture(GL_TEXTURE0);
+
+		for (int i = 0; i < levels; i++) {
+			glBindFramebuffer(GL_FRAMEBUFFER, levelFBOs[i]);
+			glViewport(0, 0, levelWidths[i], levelHeights[i]);
+
+			downsampleShader.setVec2("halfPixel", 0.5f / levelWidths[i], 0.5f / levelHeights[i]);
+			glBindTexture(GL_TEXTURE_2D, i == 0 ? inputTex : levelTextures[i - 1]);
+
+			Quad::render();
+		}
+	}
+
+	{
+		TraceScope trace("blur upsample");
+
+		upsampleShader.use();
+		upsampleShader.setInt("tex", 0);
+		upsampleShader.setFloat("offset", offset);
+		glActiveTexture(GL_TEXTURE0);
+
+		// the last pass lands in the full resolution output
+		for (int i = levels - 1; i >= 0; i--) {
+			int targetWidth = i == 0 ? width : levelWidths[i - 1];
+			int targetHeight = i == 0 ? height : levelHeights[i - 1];
+
+			glBindFramebuffer(GL_FRAMEBUFFER, i == 0 ? FBOY : levelFBOs[i - 1]);
+			glViewport(0, 0, targetWidth, targetHeight);
+
+			upsampleShader.setVec2("halfPixel", 0.5f / targetWidth, 0.5f / targetHeight);
+			glBindTexture(GL_TEXTURE_2D, levelTextures[i]);
+
+			Quad::render();
+		}
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glViewport(0, 0, width, height);
+
+	return outY;
 }
 
 unsigned int &BlurGL::getBlur() {
@@ -10,11 +10,27 @@
 
 #include <shader.h>
 
+#include <vector>
+
 #include "RenderObject.h"
 
+// GAUSSIAN_BLUR runs one separable gaussian at full resolution, as wide as blurIterations passes of the original
+// 11 tap kernel stacked on top of each other.
+// DUAL_BLUR halves the image down a small pyramid and bilinearly upsamples it back (the dual filter), picking the
+// depth and tap spread so the spread matches what the gaussian would reach with the same iterations.
+enum BlurMode { GAUSSIAN_BLUR = 0, DUAL_BLUR = 1 };
+
 class BlurGL {
 public:
+	// deepest pyramid the dual filter builds, level 0 is the full resolution output
+	static const int MAX_LEVELS = 8;
+	// pairs of neighbouring texels the gaussian reads per side with one bilinear fetch each, gausian_blur.fs sizes
+	// its arrays to match
+	static const int MAX_TAP_PAIRS = 16;
+
 	Shader shader;
+	Shader downsampleShader;
+	Shader upsampleShader;
 	unsigned int FBOX;
 	unsigned int FBOY;
 	unsigned int outX;
@@ -23,15 +39,40 @@ public:
 	int width;
 	int height;
 
+	// internal format of the two pass textures
+	unsigned int format;
+
 	float strength;
 
+	BlurMode mode;
+
+	// the gaussian kernel loaded into the shader, a centre tap and then one tap per pair of texels
+	float kernelSigma;
+	std::vector<float> tapOffsets;
+	std::vector<float> tapWeights;
+
+	// levels 1 and up of the dual filter pyramid, each half the size of the one above
+	std::vector<unsigned int> levelFBOs;
+	std::vector<unsigned int> levelTextures;
+	std::vector<int> levelWidths;
+	std::vector<int> levelHeights;
+
 	BlurGL();
 	BlurGL(int width, int height);
 
 	void setup(int width, int height);
+	// reallocates the pass textures if format is new
+	void setFormat(unsigned int format);
 	unsigned int &process(int width, int height, unsigned int &inputTex, int blurIterations = 1);
+	// one pass down and back up the pyramid in place of blurIterations gaussian passes
+	unsigned int &processDual(unsigned int &inputTex, int blurIterations);
 
 	unsigned int &getBlur();
 
 	bool isSizeInvalid(int width, int height);
+
+private:
+	void setupLevels();
+	// recomputes the weights and uploads them if sigma is new
+	void setKernel(float sigma);
 };
\ No newline at end of file
@@ -0,0 +1,262 @@
+#include "Checkpoint.h"
+
+#include <cstring>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+#include "MappedFile.h"
+
+using namespace std;
+
+static_assert(sizeof(CheckpointHeader) <= CHECKPOINT_PAGE_SIZE, "the checkpoint header has to fit in its page");
+
+static const uint32_t BYTE_ORDER_MARK = 0x01020304;
+static const int TRACER_FLOATS = 5;
+
+static uint64_t roundUpToPage(uint64_t offset) {
+	return (offset + CHECKPOINT_PAGE_SIZE - 1) / CHECKPOINT_PAGE_SIZE * CHECKPOINT_PAGE_SIZE;
+}
+
+// the field a section holds, nullptr for the sections that aren't fields
+static Field2D* sectionField(FluidBox &fluid, int section) {
+	switch (section) {
+	case VELOCITY_X_SECTION: return &fluid.velocity->getXList();
+	case VELOCITY_Y_SECTION: return &fluid.velocity->getYList();
+	case VELOCITY_PREV_X_SECTION: return &fluid.velocityPrev->getXList();
+	case VELOCITY_PREV_Y_SECTION: return &fluid.velocityPrev->getYList();
+	case DENSITY_R_SECTION: return &fluid.density[0];
+	case DENSITY_G_SECTION: return &fluid.density[1];
+	case DENSITY_B_SECTION: return &fluid.density[2];
+	case PREV_DENSITY_R_SECTION: return &fluid.prevDensity[0];
+	case PREV_DENSITY_G_SECTION: return &fluid.prevDensity[1];
+	case PREV_DENSITY_B_SECTION: return &fluid.prevDensity[2];
+	case PRESSURE_SECTION: return &fluid.pressure;
+	default: return nullptr;
+	}
+}
+
+bool saveCheckpoint(FluidBox &fluid, string path, string &error) {
+	CheckpointHeader header;
+	memset(&header, 0, sizeof(header));
+
+	memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+	header.version = CHECKPOINT_VERSION;
+	header.headerBytes = sizeof(CheckpointHeader);
+	header.pageSize = CHECKPOINT_PAGE_SIZE;
+	header.byteOrder = BYTE_ORDER_MARK;
+
+	header.size = fluid.size;
+	header.pitch = fluid.density[0].pitch;
+
+	header.dt = fluid.dt;
+	header.diff = fluid.diff;
+	header.visc = fluid.visc;
+	header.divIter = fluid.divIter;
+	header.solverMode = fluid.solverMode;
+	header.pressureSolver = fluid.pressureSolver;
+	header.multigridCycles = fluid.multigridCycles;
+	header.multigridCycle = fluid.multigridCycle;
+	header.pressureTolerance = fluid.pressureTolerance;
+	header.pressureMaxIterations = fluid.pressureMaxIterations;
+	header.velocityFrozen = fluid.velocityFrozen ? 1 : 0;
+	header.updateCount = fluid.updateCount;
+	header.pressureResidual = fluid.pressureResidual;
+	header.pressureIterations = fluid.pressureIterations;
+	header.tracerCount = fluid.tracers.size();
+
+	vector<float> tracers;
+	tracers.reserve(fluid.tracers.size() * TRACER_FLOATS);
+	for (int i = 0; i < fluid.tracers.size(); i++) {
+		Tracer &tracer = fluid.tracers[i];
+		tracers.push_back(tracer.pos.x);
+		tracers.push_back(tracer.pos.y);
+		tracers.push_back(tracer.color.x);
+		tracers.push_back(tracer.color.y);
+		tracers.push_back(tracer.color.z);
+	}
+
+	ostringstream randomStream;
+	randomStream << fluid.random;
+	string randomState = randomStream.str();
+
+	// sections one after the other, each starting on a fresh page
+	uint64_t offset = CHECKPOINT_PAGE_SIZE;
+	for (int i = 0; i < CHECKPOINT_SECTION_COUNT; i++) {
+		Field2D* field = sectionField(fluid, i);
+
+		uint64_t bytes;
+		if (field != nullptr) {
+			bytes = field->data.size() * sizeof(float);
+		}
+		else if (i == TRACERS_SECTION) {
+			bytes = tracers.size() * sizeof(float);
+		}
+		else {
+			bytes = randomState.size();
+		}
+
+		header.sections[i].offset = offset;
+		header.sections[i].bytes = bytes;
+		offset = roundUpToPage(offset + bytes);
+	}
+
+	// written next to the target and moved over it at the end so a crash mid save never leaves a broken checkpoint behind
+	string tempPath = path + ".tmp";
+	{
+		ofstream file(tempPath, ios::binary);
+		if (!file) {
+			error = "could not open " + tempPath;
+			return false;
+		}
+
+		file.write((const char*)&header, sizeof(header));
+
+		for (int i = 0; i < CHECKPOINT_SECTION_COUNT; i++) {
+			file.seekp(header.sections[i].offset);
+
+			Field2D* field = sectionField(fluid, i);
+			if (field != nullptr) {
+				file.write((const char*)field->data.data(), header.sections[i].bytes);
+			}
+			else if (i == TRACERS_SECTION) {
+				file.write((const char*)tracers.data(), header.sections[i].bytes);
+			}
+			else {
+				file.write(randomState.data(), header.sections[i].bytes);
+			}
+		}
+
+		if (!file) {
+			error = "could not write " + tempPath;
+			file.close();
+			remove(tempPath.c_str());
+			return false;
+		}
+	}
+
+	// rename replaces the target in one step on posix, windows won't rename over an existing file
+#ifdef _WIN32
+	remove(path.c_str());
+#endif
+	if (rename(tempPath.c_str(), path.c_str()) != 0) {
+		error = "could not move " + tempPath + " to " + path;
+		return false;
+	}
+
+	return true;
+}
+
+bool loadCheckpoint(FluidBox &fluid, string path, string &error) {
+	MappedFile file;
+	if (!file.open(path)) {
+		error = "could not open " + path;
+		return false;
+	}
+
+	if (file.size() < sizeof(CheckpointHeader)) {
+		error = path + " is too small to be a checkpoint";
+		return false;
+	}
+
+	CheckpointHeader header;
+	memcpy(&header, file.data(), sizeof(header));
+
+	if (memcmp(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic)) != 0) {
+		error = path + " is not a checkpoint";
+		return false;
+	}
+	if (header.byteOrder != BYTE_ORDER_MARK) {
+		error = path + " was saved on a machine with a different byte order";
+		return false;
+	}
+	if (header.version != CHECKPOINT_VERSION || header.headerBytes != sizeof(CheckpointHeader) || header.pageSize != CHECKPOINT_PAGE_SIZE) {
+		error = path + " is checkpoint version " + to_string(header.version) + ", this build reads version " + to_string(CHECKPOINT_VERSION);
+		return false;
+	}
+
+	// the padding has to match what a field of this size gets here for the sections to copy straight in
+	int expectedPitch = (header.size + Field2D::ROW_MULTIPLE - 1) / Field2D::ROW_MULTIPLE * Field2D::ROW_MULTIPLE;
+	if (header.size < 8 || header.pitch != expectedPitch) {
+		error = path + " has a grid this build can't hold";
+		return false;
+	}
+
+	// settings the sim would otherwise run on outside anything the set commands allow
+	bool settingsValid =
+		(header.solverMode == GAUSS_SEIDEL || header.solverMode == RED_BLACK_GAUSS_SEIDEL) &&
+		header.pressureSolver >= RELAXATION && header.pressureSolver <= SPECTRAL &&
+		(header.multigridCycle == V_CYCLE || header.multigridCycle == F_CYCLE) &&
+		header.multigridCycles >= 1 && header.pressureMaxIterations >= 1;
+	if (!settingsValid) {
+		error = path + " has settings this build doesn't know";
+		return false;
+	}
+
+	uint64_t fieldBytes = uint64_t(header.pitch) * header.size * sizeof(float);
+	for (int i = 0; i < CHECKPOINT_SECTION_COUNT; i++) {
+		CheckpointSection &section = header.sections[i];
+
+		uint64_t expectedBytes = section.bytes;
+		if (sectionField(fluid, i) != nullptr) {
+			expectedBytes = fieldBytes;
+		}
+		else if (i == TRACERS_SECTION) {
+			expectedBytes = header.tracerCount * TRACER_FLOATS * sizeof(float);
+		}
+
+		if (section.bytes != expectedBytes || section.offset % CHECKPOINT_PAGE_SIZE != 0 || section.offset > file.size() || section.bytes > file.size() - section.offset) {
+			error = path + " is damaged or cut short";
+			return false;
+		}
+	}
+
+	// parsed before anything is touched so a bad generator state can't leave the fluid half loaded
+	std::mt19937 random;
+	{
+		CheckpointSection &section = header.sections[RANDOM_SECTION];
+		istringstream randomStream(string((const char*)file.data() + section.offset, size_t(section.bytes)));
+		randomStream >> random;
+		if (!randomStream) {
+			error = path + " is damaged or cut short";
+			return false;
+		}
+	}
+
+	fluid.size = header.size;
+	fluid.clear();
+
+	for (int i = 0; i < CHECKPOINT_SECTION_COUNT; i++) {
+		Field2D* field = sectionField(fluid, i);
+		if (field != nullptr) {
+			memcpy(field->data.data(), file.data() + header.sections[i].offset, size_t(fieldBytes));
+		}
+	}
+
+	const float* tracers = (const float*)(file.data() + header.sections[TRACERS_SECTION].offset);
+	fluid.tracers.reserve(size_t(header.tracerCount));
+	for (uint64_t i = 0; i < header.tracerCount; i++) {
+		const float* tracer = tracers + i * TRACER_FLOATS;
+		fluid.tracers.push_back(Tracer(glm::vec2(tracer[0], tracer[1]), glm::vec3(tracer[2], tracer[3], tracer[4])));
+	}
+
+	fluid.random = random;
+
+	fluid.dt = header.dt;
+	fluid.diff = header.diff;
+	fluid.visc = header.visc;
+	fluid.divIter = header.divIter;
+	fluid.solverMode = SolverMode(header.solverMode);
+	fluid.pressureSolver = PressureSolver(header.pressureSolver);
+	fluid.multigridCycles = header.multigridCycles;
+	fluid.multigridCycle = MultigridCycle(header.multigridCycle);
+	fluid.pressureTolerance = header.pressureTolerance;
+	fluid.pressureMaxIterations = header.pressureMaxIterations;
+	fluid.velocityFrozen = header.velocityFrozen != 0;
+	fluid.updateCount = header.updateCount;
+	fluid.pressureResidual = header.pressureResidual;
+	fluid.pressureIterations = header.pressureIterations;
+
+	return true;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "FluidBox.h"
+
+// Saves the whole state of a FluidBox (every field, the tracers, the settings that change the result and the brush
+// jitter's generator) to one file and loads it back.
+//
+// The file is a fixed header followed by one section per field, each section starts on a page boundary and holds the
+// field exactly as it sits in memory (padded rows included). Loading maps the file and copies each section straight
+// into its field, nothing is parsed so even a large grid restores about as fast as it can be read.
+// Thread count and simd level belong to the machine, not the run, and aren't saved.
+//
+// layout (native byte order, checked on load):
+//   page 0:      CheckpointHeader
+//   each section: offset and byte count in header.sections, offsets are multiples of CHECKPOINT_PAGE_SIZE
+static const char CHECKPOINT_MAGIC[8] = { 'F', 'L', 'U', 'I', 'D', 'C', 'K', 'P' };
+static const uint32_t CHECKPOINT_VERSION = 1;
+static const uint32_t CHECKPOINT_PAGE_SIZE = 4096;
+
+enum CheckpointSectionId {
+	VELOCITY_X_SECTION = 0,
+	VELOCITY_Y_SECTION,
+	VELOCITY_PREV_X_SECTION,
+	VELOCITY_PREV_Y_SECTION,
+	DENSITY_R_SECTION,
+	DENSITY_G_SECTION,
+	DENSITY_B_SECTION,
+	PREV_DENSITY_R_SECTION,
+	PREV_DENSITY_G_SECTION,
+	PREV_DENSITY_B_SECTION,
+	PRESSURE_SECTION,
+	// 5 floats per tracer: x, y, r, g, b
+	TRACERS_SECTION,
+	// the generator's state as text
+	RANDOM_SECTION,
+	CHECKPOINT_SECTION_COUNT
+};
+
+struct CheckpointSection {
+	uint64_t offset;
+	uint64_t bytes;
+};
+
+struct CheckpointHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t headerBytes;
+	uint32_t pageSize;
+	// reads back as 0x01020304 only on a machine with the same byte order
+	uint32_t byteOrder;
+
+	// grid
+	int32_t size;
+	int32_t pitch;
+
+	// settings
+	float dt;
+	float diff;
+	float visc;
+	float divIter;
+	int32_t solverMode;
+	int32_t pressureSolver;
+	int32_t multigridCycles;
+	int32_t multigridCycle;
+	float pressureTolerance;
+	int32_t pressureMaxIterations;
+	int32_t velocityFrozen;
+	int32_t updateCount;
+
+	// last pressure solve
+	float pressureResidual;
+	int32_t pressureIterations;
+
+	uint64_t tracerCount;
+
+	CheckpointSection sections[CHECKPOINT_SECTION_COUNT];
+};
+
+// both return false and fill in error if something went wrong, a failed load leaves the fluid untouched
+bool saveCheckpoint(FluidBox &fluid, std::string path, std::string &error);
+bool loadCheckpoint(FluidBox &fluid, std::string path, std::string &error);
@@ -0,0 +1,234 @@
+#include "ConjugateGradient.h"
+
+#include <algorithm>
+#include <cmath>
+
+ConjugateGradient::ConjugateGradient() {
+	tau = 0.97f;
+	sigma = 0.25f;
+
+	n = 0;
+}
+
+// allocates the work grids and factors the preconditioner for a size x size grid
+void ConjugateGradient::build(int size) {
+	n = size - 2;
+
+	precon = Field2D(size, size);
+	r = Field2D(size, size);
+	z = Field2D(size, size);
+	s = Field2D(size, size);
+	q = Field2D(size, size);
+
+	rowSums = std::vector<double>(size, 0);
+
+	// every interior cell couples to each interior neighbour with -1 and to itself with 4
+	// the ring of precon stays 0 so the terms for missing neighbours drop out on their own
+	for (int y = 1; y <= n; y++) {
+		for (int x = 1; x <= n; x++) {
+			float left = precon[y][x - 1];
+			float below = precon[y - 1][x];
+
+			// the left cell's neighbour above it and the lower cell's neighbour to its right (only if they are interior)
+			float leftUp = (y + 1 <= n) ? 1.0f : 0.0f;
+			float belowRight = (x + 1 <= n) ? 1.0f : 0.0f;
+
+			float e = 4.0f
+				- left * left
+				- below * below
+				- tau * (leftUp * left * left + belowRight * below * below);
+
+			if (e < sigma * 4.0f) {
+				e = 4.0f;
+			}
+
+			precon[y][x] = 1.0f / std::sqrt(e);
+		}
+	}
+}
+
+int ConjugateGradient::solve(Field2D &p, Field2D &div, float tolerance, int maxIterations, ThreadPool* pool, float &residual) {
+	if (n != p.width - 2) {
+		build(p.width);
+	}
+
+	int iterations = 0;
+
+	// the updated residual drifts away from the real one in single precision, so once it claims to be converged the real
+	// residual is measured again and the iteration restarts from it if it is still above the tolerance
+	while (true) {
+		computeResidual(p, div, pool);
+
+		residual = maxAbs(r, pool);
+		if (residual <= tolerance || iterations >= maxIterations) {
+			return iterations;
+		}
+
+		applyPreconditioner();
+		s.data = z.data;
+
+		double sigmaDot = dot(r, z, pool);
+
+		while (iterations < maxIterations) {
+			iterations++;
+
+			applyOperator(s, q, pool);
+
+			double sq = dot(s, q, pool);
+			if (sq == 0) {
+				break;
+			}
+
+			float alpha = float(sigmaDot / sq);
+
+			// step along s and track the largest remaining residual at the same time
+			pool->parallelFor(1, n + 1, [&](int yStart, int yEnd) {
+				for (int y = yStart; y < yEnd; y++) {
+					float* pRow = p[y];
+					float* rRow = r[y];
+					const float* sRow = s[y];
+					const float* qRow = q[y];
+
+					float rowMax = 0;
+					for (int x = 1; x <= n; x++) {
+						pRow[x] += alpha * sRow[x];
+						rRow[x] -= alpha * qRow[x];
+						rowMax = std::max(rowMax, std::abs(rRow[x]));
+					}
+
+					rowSums[y] = rowMax;
+				}
+			});
+
+			float updatedResidual = 0;
+			for (int y = 1; y <= n; y++) {
+				updatedResidual = std::max(updatedResidual, float(rowSums[y]));
+			}
+
+			if (updatedResidual <= tolerance) {
+				break;
+			}
+
+			applyPreconditioner();
+
+			double sigmaNew = dot(r, z, pool);
+			float beta = float(sigmaNew / sigmaDot);
+			sigmaDot = sigmaNew;
+
+			pool->parallelFor(1, n + 1, [&](int yStart, int yEnd) {
+				for (int y = yStart; y < yEnd; y++) {
+					float* sRow = s[y];
+					const float* zRow = z[y];
+
+					for (int x = 1; x <= n; x++) {
+						sRow[x] = zRow[x] + beta * sRow[x];
+					}
+				}
+			});
+		}
+	}
+}
+
+// r = div - A * p, the ring of p acts as the boundary values
+void ConjugateGradient::computeResidual(Field2D &p, Field2D &div, ThreadPool* pool) {
+	pool->parallelFor(1, n + 1, [&](int yStart, int yEnd) {
+		for (int y = yStart; y < yEnd; y++) {
+			const float* up = p[y - 1];
+			const float* row = p[y];
+			const float* down = p[y + 1];
+			const float* divRow = div[y];
+			float* rRow = r[y];
+
+			for (int x = 1; x <= n; x++) {
+				rRow[x] = divRow[x] - (4.0f * row[x] - up[x] - down[x] - row[x - 1] - row[x + 1]);
+			}
+		}
+	});
+}
+
+// z = M^-1 r with M = L L^T, a forward then a backward substitution
+// both sweeps depend on the cell before them so this part stays on one thread
+void ConjugateGradient::applyPreconditioner() {
+	for (int y = 1; y <= n; y++) {
+		float* zRow = z[y];
+		const float* zBelow = z[y - 1];
+		const float* rRow = r[y];
+		const float* pRow = precon[y];
+		const float* pBelow = precon[y - 1];
+
+		for (int x = 1; x <= n; x++) {
+			zRow[x] = (rRow[x] + pRow[x - 1] * zRow[x - 1] + pBelow[x] * zBelow[x]) * pRow[x];
+		}
+	}
+
+	for (int y = n; y >= 1; y--) {
+		float* zRow = z[y];
+		const float* zAbove = z[y + 1];
+		const float* pRow = precon[y];
+
+		for (int x = n; x >= 1; x--) {
+			zRow[x] = (zRow[x] + pRow[x] * (zRow[x + 1] + zAbove[x])) * pRow[x];
+		}
+	}
+}
+
+// out = A * in for a grid whose ring is zero
+void ConjugateGradient::applyOperator(Field2D &in, Field2D &out, ThreadPool* pool) {
+	pool->parallelFor(1, n + 1, [&](int yStart, int yEnd) {
+		for (int y = yStart; y < yEnd; y++) {
+			const float* up = in[y - 1];
+			const float* row = in[y];
+			const float* down = in[y + 1];
+			float* outRow = out[y];
+
+			for (int x = 1; x <= n; x++) {
+				outRow[x] = 4.0f * row[x] - up[x] - down[x] - row[x - 1] - row[x + 1];
+			}
+		}
+	});
+}
+
+double ConjugateGradient::dot(Field2D &a, Field2D &b, ThreadPool* pool) {
+	pool->parallelFor(1, n + 1, [&](int yStart, int yEnd) {
+		for (int y = yStart; y < yEnd; y++) {
+			const float* aRow = a[y];
+			const float* bRow = b[y];
+
+			double sum = 0;
+			for (int x = 1; x <= n; x++) {
+				sum += double(aRow[x]) * bRow[x];
+			}
+
+			rowSums[y] = sum;
+		}
+	});
+
+	double total = 0;
+	for (int y = 1; y <= n; y++) {
+		total += rowSums[y];
+	}
+
+	return total;
+}
+
+float ConjugateGradient::maxAbs(Field2D &a, ThreadPool* pool) {
+	pool->parallelFor(1, n + 1, [&](int yStart, int yEnd) {
+		for (int y = yStart; y < yEnd; y++) {
+			const float* aRow = a[y];
+
+			float rowMax = 0;
+			for (int x = 1; x <= n; x++) {
+				rowMax = std::max(rowMax, std::abs(aRow[x]));
+			}
+
+			rowSums[y] = rowMax;
+		}
+	});
+
+	float total = 0;
+	for (int y = 1; y <= n; y++) {
+		total = std::max(total, float(rowSums[y]));
+	}
+
+	return total;
+}
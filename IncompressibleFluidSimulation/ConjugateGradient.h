@@ -0,0 +1,44 @@
+#pragma once
+
+#include <vector>
+
+#include "Field2D.h"
+#include "ThreadPool.h"
+
+// Matrix free preconditioned conjugate gradient for the same pressure problem the other backends solve:
+// 4p - (sum of the 4 neighbours) = div on the interior with the outer ring of p as a fixed boundary.
+// Preconditioned with modified incomplete cholesky (MIC(0)) which is built once per grid size.
+class ConjugateGradient {
+public:
+	// MIC(0) tuning, tau blends between plain and modified incomplete cholesky and sigma guards against tiny pivots
+	float tau;
+	float sigma;
+
+	ConjugateGradient();
+
+	// iterates until the largest residual is at most tolerance or maxIterations is hit
+	// returns the number of iterations and writes the final residual (max norm, measured from p) into residual
+	int solve(Field2D &p, Field2D &div, float tolerance, int maxIterations, ThreadPool* pool, float &residual);
+
+private:
+	int n;
+
+	Field2D precon;
+	Field2D r;
+	Field2D z;
+	Field2D s;
+	Field2D q;
+
+	// per row partial sums so reductions stay deterministic no matter how rows are split across threads
+	std::vector<double> rowSums;
+
+	void build(int size);
+
+	void computeResidual(Field2D &p, Field2D &div, ThreadPool* pool);
+	// the triangular solves depend on the cell before them in both directions so they run on the calling thread
+	void applyPreconditioner();
+	void applyOperator(Field2D &in, Field2D &out, ThreadPool* pool);
+
+	double dot(Field2D &a, Field2D &b, ThreadPool* pool);
+	float maxAbs(Field2D &a, ThreadPool* pool);
+};
@@ -0,0 +1,85 @@
+#include "DensityPacking.h"
+
+#include <vector>
+
+using namespace std;
+
+size_t texelChannelBytes(TexelFormat format) {
+	switch (format) {
+	case HALF_TEXELS:
+		return 2;
+	case SRGB8_TEXELS:
+		return 1;
+	default:
+		return 4;
+	}
+}
+
+const char* texelFormatName(TexelFormat format) {
+	switch (format) {
+	case HALF_TEXELS:
+		return "half";
+	case SRGB8_TEXELS:
+		return "srgb8";
+	default:
+		return "float";
+	}
+}
+
+// the interleaved float row goes through the kernel that converts it
+static void convertTexels(FluidBox &fluidBox, TexelFormat format, const float* texels, void* out, size_t offset, int count) {
+	switch (format) {
+	case HALF_TEXELS:
+		fluidBox.kernels.halfRow((unsigned short*)out + offset, texels, count);
+		break;
+	case SRGB8_TEXELS:
+		fluidBox.kernels.srgbRow((unsigned char*)out + offset, texels, count);
+		break;
+	default:
+		break;
+	}
+}
+
+void packDensityTexels(FluidBox &fluidBox, TexelFormat format, void* data) {
+	int rowFloats = fluidBox.size * DENSITY_TEXEL_FLOATS;
+
+	// rows are independent so they are filled in across the sim's thread pool
+	fluidBox.threadPool->parallelFor(0, fluidBox.size, [&](int yStart, int yEnd) {
+		// the smaller formats are interleaved into a float row first and converted from there
+		vector<float> row(format == FLOAT_TEXELS ? 0 : rowFloats);
+
+		for (int y = yStart; y < yEnd; y++) {
+			float* texel = format == FLOAT_TEXELS ? (float*)data + size_t(y) * rowFloats : row.data();
+
+			const float* red = fluidBox.density[0][y];
+			const float* green = fluidBox.density[1][y];
+			const float* blue = fluidBox.density[2][y];
+
+			// get color from the rgb density maps in the fluid sim
+			for (int x = 0; x < fluidBox.size; x++) {
+				texel[0] = red[x];
+				texel[1] = green[x];
+				texel[2] = blue[x];
+
+				texel += DENSITY_TEXEL_FLOATS;
+			}
+
+			convertTexels(fluidBox, format, row.data(), data, size_t(y) * rowFloats, rowFloats);
+		}
+	});
+}
+
+void setDensityTexel(FluidBox &fluidBox, TexelFormat format, void* data, size_t cell, glm::vec3 color) {
+	float texel[DENSITY_TEXEL_FLOATS] = { color.x, color.y, color.z };
+	size_t offset = cell * DENSITY_TEXEL_FLOATS;
+
+	if (format == FLOAT_TEXELS) {
+		float* out = (float*)data + offset;
+		out[0] = texel[0];
+		out[1] = texel[1];
+		out[2] = texel[2];
+		return;
+	}
+
+	convertTexels(fluidBox, format, texel, data, offset, DENSITY_TEXEL_FLOATS);
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstddef>
+
+#include "FluidBox.h"
+
+// floats per cell in the texture the viewer draws, rgb density
+static const int DENSITY_TEXEL_FLOATS = 3;
+
+// What the density is converted to for the trip to the gpu, it's only ever looked at so it doesn't need full floats.
+// HALF_TEXELS keeps values above 1 like the floats do, SRGB8_TEXELS clamps to [0, 1] as the screen would and spends its
+// 8 bits along the srgb curve so dark smoke doesn't band.
+enum TexelFormat { FLOAT_TEXELS = 0, HALF_TEXELS = 1, SRGB8_TEXELS = 2 };
+
+// bytes of one channel of one cell
+std::size_t texelChannelBytes(TexelFormat format);
+
+const char* texelFormatName(TexelFormat format);
+
+// fills data (size * size * DENSITY_TEXEL_FLOATS channels in format) with the rgb densities of each cell, row by row across
+// the sim's thread pool
+void packDensityTexels(FluidBox &fluidBox, TexelFormat format, void* data);
+
+// overwrites the color of one cell of data packed by packDensityTexels
+void setDensityTexel(FluidBox &fluidBox, TexelFormat format, void* data, std::size_t cell, glm::vec3 color);
@@ -0,0 +1,118 @@
+#include "FFT.h"
+
+#include <cmath>
+
+static const double PI = 3.14159265358979323846;
+
+FFT::FFT() {
+	length = 0;
+	radixLength = 0;
+	powerOfTwo = true;
+}
+
+FFT::FFT(int length) {
+	this->length = length;
+
+	powerOfTwo = (length & (length - 1)) == 0;
+
+	// bluestein needs a linear convolution of length 2 * length - 1 without wrapping around
+	radixLength = 1;
+	int minimum = powerOfTwo ? length : 2 * length - 1;
+	while (radixLength < minimum) {
+		radixLength *= 2;
+	}
+
+	int bits = 0;
+	while ((1 << bits) < radixLength) {
+		bits++;
+	}
+
+	bitReverse = std::vector<int>(radixLength, 0);
+	for (int i = 0; i < radixLength; i++) {
+		int reversed = 0;
+		for (int b = 0; b < bits; b++) {
+			if (i & (1 << b)) {
+				reversed |= 1 << (bits - 1 - b);
+			}
+		}
+		bitReverse[i] = reversed;
+	}
+
+	roots = std::vector<std::complex<double>>(radixLength / 2 + 1);
+	for (int i = 0; i < roots.size(); i++) {
+		roots[i] = std::polar(1.0, -2.0 * PI * i / radixLength);
+	}
+
+	if (powerOfTwo) {
+		return;
+	}
+
+	chirp = std::vector<std::complex<double>>(length);
+	for (long long j = 0; j < length; j++) {
+		// j^2 mod 2 * length keeps the angle small so large j do not lose precision
+		long long wrapped = (j * j) % (2LL * length);
+		chirp[j] = std::polar(1.0, -PI * double(wrapped) / length);
+	}
+
+	filter = std::vector<std::complex<double>>(radixLength, 0);
+	filter[0] = std::conj(chirp[0]);
+	for (int j = 1; j < length; j++) {
+		filter[j] = std::conj(chirp[j]);
+		filter[radixLength - j] = std::conj(chirp[j]);
+	}
+	radix2(filter.data(), false);
+}
+
+int FFT::scratchSize() {
+	return powerOfTwo ? 0 : radixLength;
+}
+
+void FFT::forward(std::complex<double>* data, std::complex<double>* scratch) {
+	if (powerOfTwo) {
+		radix2(data, false);
+		return;
+	}
+
+	// X_k = chirp_k * sum (x_j chirp_j) conj(chirp_(k - j)), a convolution done with the radix 2 transform
+	for (int j = 0; j < length; j++) {
+		scratch[j] = data[j] * chirp[j];
+	}
+	for (int j = length; j < radixLength; j++) {
+		scratch[j] = 0;
+	}
+
+	radix2(scratch, false);
+	for (int j = 0; j < radixLength; j++) {
+		scratch[j] *= filter[j];
+	}
+	radix2(scratch, true);
+
+	double scale = 1.0 / radixLength;
+	for (int k = 0; k < length; k++) {
+		data[k] = scratch[k] * chirp[k] * scale;
+	}
+}
+
+// unscaled iterative cooley tukey on radixLength values
+void FFT::radix2(std::complex<double>* data, bool inverse) {
+	for (int i = 0; i < radixLength; i++) {
+		int j = bitReverse[i];
+		if (i < j) {
+			std::swap(data[i], data[j]);
+		}
+	}
+
+	for (int half = 1; half < radixLength; half *= 2) {
+		int step = radixLength / (2 * half);
+
+		for (int start = 0; start < radixLength; start += 2 * half) {
+			for (int k = 0; k < half; k++) {
+				std::complex<double> w = inverse ? std::conj(roots[k * step]) : roots[k * step];
+				std::complex<double> odd = w * data[start + k + half];
+
+				data[start + k + half] = data[start + k] - odd;
+				data[start + k] += odd;
+			}
+		}
+	}
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <complex>
+#include <vector>
+
+// Complex discrete fourier transform of one fixed length.
+// Powers of two use an iterative radix 2 transform, every other length goes through bluestein's algorithm
+// (a radix 2 convolution of at least twice the length) so any grid size can be transformed in O(n log n).
+class FFT {
+public:
+	int length;
+
+	FFT();
+	FFT(int length);
+
+	// number of complex values the scratch buffer passed to forward needs
+	int scratchSize();
+
+	// in place forward transform X_k = sum x_j e^(-2 pi i jk / length)
+	// scratch is only touched for non power of two lengths, one buffer per thread
+	void forward(std::complex<double>* data, std::complex<double>* scratch);
+
+private:
+	// size of the radix 2 transform that does the actual work
+	int radixLength;
+	bool powerOfTwo;
+
+	std::vector<int> bitReverse;
+	std::vector<std::complex<double>> roots;
+
+	// bluestein chirp e^(-pi i j^2 / length) and the transformed convolution filter built from it
+	std::vector<std::complex<double>> chirp;
+	std::vector<std::complex<double>> filter;
+
+	void radix2(std::complex<double>* data, bool inverse);
+};
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <new>
+#include <vector>
+
+// hands out blocks aligned to a cache line so the first row of a field always starts on one
+template <typename T, std::size_t Alignment>
+struct AlignedAllocator {
+	typedef T value_type;
+
+	template <typename U>
+	struct rebind {
+		typedef AlignedAllocator<U, Alignment> other;
+	};
+
+	AlignedAllocator() {}
+
+	template <typename U>
+	AlignedAllocator(const AlignedAllocator<U, Alignment>&) {}
+
+	T* allocate(std::size_t n) {
+		return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(Alignment)));
+	}
+
+	void deallocate(T* p, std::size_t) {
+		::operator delete(p, std::align_val_t(Alignment));
+	}
+
+	template <typename U>
+	bool operator==(const AlignedAllocator<U, Alignment>&) const { return true; }
+
+	template <typename U>
+	bool operator!=(const AlignedAllocator<U, Alignment>&) const { return false; }
+};
+
+// A single contiguous row-major 2d grid of floats.
+// Rows are padded out to "pitch" floats so every row starts on a 64 byte boundary.
+// Indexing with field[y][x] only costs one multiply instead of chasing a pointer per row.
+struct Field2D {
+	static const int ALIGNMENT = 64;
+	static const int ROW_MULTIPLE = ALIGNMENT / sizeof(float);
+
+	int width;
+	int height;
+	int pitch;
+
+	std::vector<float, AlignedAllocator<float, ALIGNMENT>> data;
+
+	Field2D() {
+		width = 0;
+		height = 0;
+		pitch = 0;
+	}
+
+	Field2D(int width, int height, float default_value = 0) {
+		this->width = width;
+		this->height = height;
+		this->pitch = ((width + ROW_MULTIPLE - 1) / ROW_MULTIPLE) * ROW_MULTIPLE;
+
+		data = std::vector<float, AlignedAllocator<float, ALIGNMENT>>(std::size_t(pitch) * height, default_value);
+	}
+
+	// (access y, x)
+	float* operator[](int y) {
+		return data.data() + std::size_t(y) * pitch;
+	}
+
+	const float* operator[](int y) const {
+		return data.data() + std::size_t(y) * pitch;
+	}
+
+	float& at(int x, int y) {
+		return data[std::size_t(y) * pitch + x];
+	}
+
+	float at(int x, int y) const {
+		return data[std::size_t(y) * pitch + x];
+	}
+
+	void fill(float value) {
+		std::fill(data.begin(), data.end(), value);
+	}
+
+	std::size_t cells() const {
+		return std::size_t(width) * height;
+	}
+};
@@ -29,37 +29,102 @@ FluidBox::FluidBox(int size, float diffusion, float viscosity, float dt) {
 
 	velocityFrozen = false;
 
+	solverMode = SolverMode::GAUSS_SEIDEL;
+
+	pressureSolver = PressureSolver::RELAXATION;
+	multigridCycles = 2;
+	multigridCycle = MultigridCycle::V_CYCLE;
+	pressureTolerance = 0.000001f;
+	pressureMaxIterations = 200;
+
+	pressureResidual = 0;
+	pressureIterations = 0;
+
+	velocityPrev = nullptr;
+	velocity = nullptr;
+
+	threadPool = new ThreadPool();
+
+	velocityDiffusePhase = profiler.addPhase("velocity diffuse");
+	velocityAdvectPhase = profiler.addPhase("velocity advect");
+	projectPhase = profiler.addPhase("project");
+	densityDiffusePhase = profiler.addPhase("density diffuse");
+	densityAdvectPhase = profiler.addPhase("density advect");
+	tracersPhase = profiler.addPhase("tracers");
+
 	// init 2d arrays
 	clear();
 };
 
+FluidBox::~FluidBox() {
+	delete velocityPrev;
+	delete velocity;
+	delete threadPool;
+}
+
+// swaps in a new pool between updates, 0 uses every hardware thread
+void FluidBox::setThreadCount(int threadCount) {
+	delete threadPool;
+	threadPool = new ThreadPool(threadCount);
+}
+
+void FluidBox::seedRandom(unsigned int seed) {
+	random.seed(seed);
+}
+
 // the main update step
 void FluidBox::update() {
-	vector<vector<float>>& vPrevXList = velocityPrev->getXList();
-	vector<vector<float>>& vPrevYList = velocityPrev->getYList();
+	Field2D& vPrevXList = velocityPrev->getXList();
+	Field2D& vPrevYList = velocityPrev->getYList();
 	
-	vector<vector<float>>& vXList = velocity->getXList();
-	vector<vector<float>>& vYList = velocity->getYList();
+	Field2D& vXList = velocity->getXList();
+	Field2D& vYList = velocity->getYList();
 
 	if (!velocityFrozen) {
-		diffuse(vPrevXList, vXList, 1);
-		diffuse(vPrevYList, vYList, 2);
+		{
+			ScopedTimer timer(profiler, velocityDiffusePhase);
+			diffuse(vPrevXList, vXList, 1);
+			diffuse(vPrevYList, vYList, 2);
+		}
 
-		//project(vPrevXList, vPrevYList, vXList, vYList);
+		//project(vPrevXList, vPrevYList, vXList);
 
-		advect(1, vPrevXList, vPrevYList, vXList, vPrevXList);
-		advect(2, vPrevXList, vPrevYList, vYList, vPrevYList);
+		{
+			ScopedTimer timer(profiler, velocityAdvectPhase);
 
-		project(vXList, vYList, vPrevXList, vPrevYList);
+			// both components ride the same (previous) velocity so they share one backtrace
+			vector<AdvectedField> velocityFields = {
+				AdvectedField(vXList, vPrevXList, 1),
+				AdvectedField(vYList, vPrevYList, 2)
+			};
+			advectFields(vPrevXList, vPrevYList, velocityFields);
+		}
+
+		{
+			ScopedTimer timer(profiler, projectPhase);
+			project(vXList, vYList, vPrevYList);
+		}
 	}
 
-	// applys advection for each color channel
-	for (int i = 0; i < 3; i++) {
-		diffuse(prevDensity[i], density[i], 0);
-		advect(0, vXList, vYList, density[i], prevDensity[i]);
+	// diffuses each color channel then advects all three along one backtrace
+	vector<AdvectedField> densityFields;
+	{
+		ScopedTimer timer(profiler, densityDiffusePhase);
+		for (int i = 0; i < 3; i++) {
+			diffuse(prevDensity[i], density[i], 0);
+			densityFields.push_back(AdvectedField(density[i], prevDensity[i], 0));
+		}
 	}
 
-	updateTracers();
+	{
+		ScopedTimer timer(profiler, densityAdvectPhase);
+		advectFields(vXList, vYList, densityFields);
+	}
+
+	{
+		ScopedTimer timer(profiler, tracersPhase);
+		updateTracers();
+	}
 
 	//std::cout << velocity->getXList()[size / 2][size / 2] << std::endl;
 	//std::cout << simDensity[size / 2][size / 2] << std::endl;
@@ -72,8 +137,8 @@ void FluidBox::resetSize(int size) {
 	int prevSize = this->size;
 	this->size = size;
 
-	vector<vector<vector<float>>> tempPrevDensity = prevDensity;
-	vector<vector<vector<float>>> tempDensity = density;
+	vector<Field2D> tempPrevDensity = prevDensity;
+	vector<Field2D> tempDensity = density;
 	vector<Tracer> tempTracers = tracers;
 	DynamicVector tempVelocityPrev = (*velocityPrev);
 	DynamicVector tempVelocity = (*velocity);
@@ -111,12 +176,12 @@ void FluidBox::resetSize(int size) {
 	}
 }
 
-void FluidBox::enforceBounds(std::vector<std::vector<float>> &v, int dim) {
+void FluidBox::enforceBounds(Field2D &v, int dim) {
 	float reflectPower = 1.0f;
 
 	// x
 	if (dim == 1) {
-		for (int y = 1; y < v.size() - 1; y++) {
+		for (int y = 1; y < v.height - 1; y++) {
 			v[y][0] = -v[y][1] * reflectPower;
 
 			v[y][size - 1] = -v[y][size - 2] * reflectPower;
@@ -146,19 +211,29 @@ void FluidBox::enforceBounds(std::vector<std::vector<float>> &v, int dim) {
 }
 
 // Accounts for divergence in the velocity vectors
-void FluidBox::removeDivergence(std::vector<std::vector<float>> &v, std::vector<std::vector<float>> &vPrev, float a, float c, int b) {
+void FluidBox::removeDivergence(Field2D &v, Field2D &vPrev, float a, float c, int b) {
+	if (solverMode == SolverMode::RED_BLACK_GAUSS_SEIDEL) {
+		removeDivergenceRedBlack(v, vPrev, a, c, b);
+		return;
+	}
+
 	float cRecip = 1 / c;
 
 	for (int i = 0; i < divIter; i++) {
 		for (int y = 1; y < size - 1; y++) {
+			float* row = v[y];
+			const float* up = v[y - 1];
+			const float* down = v[y + 1];
+			const float* prevRow = vPrev[y];
+
 			for (int x = 1; x < size - 1; x++) {
 				// remove divergence for each coord
-				v[y][x] = (vPrev[y][x] +
+				row[x] = (prevRow[x] +
 					a * (
-						v[y + 1][x] +
-						v[y - 1][x] +
-						v[y][x + 1] +
-						v[y][x - 1]
+						down[x] +
+						up[x] +
+						row[x + 1] +
+						row[x - 1]
 						)
 					) * cRecip;
 			}
@@ -168,69 +243,199 @@ void FluidBox::removeDivergence(std::vector<std::vector<float>> &v, std::vector<
 	}
 }
 
-void FluidBox::diffuse(std::vector<std::vector<float>> &v, std::vector<std::vector<float>> &vPrev, int b) {
+// Same relaxation as removeDivergence but in checkerboard order
+// a red cell ((x + y) even) only reads black neighbours and the other way around so all rows of one colour can run at once
+void FluidBox::removeDivergenceRedBlack(Field2D &v, Field2D &vPrev, float a, float c, int b) {
+	float cRecip = 1 / c;
+
+	for (int i = 0; i < divIter; i++) {
+		for (int color = 0; color < 2; color++) {
+			threadPool->parallelFor(1, size - 1, [&](int yStart, int yEnd) {
+				relaxRedBlackRows(v, vPrev, a, cRecip, color, yStart, yEnd);
+			});
+		}
+
+		enforceBounds(v, b);
+	}
+}
+
+void FluidBox::relaxRedBlackRows(Field2D &v, Field2D &vPrev, float a, float cRecip, int color, int yStart, int yEnd) {
+	for (int y = yStart; y < yEnd; y++) {
+		float* row = v[y];
+		const float* up = v[y - 1];
+		const float* down = v[y + 1];
+		const float* prevRow = vPrev[y];
+
+		// first interior cell of this colour on the row
+		int xStart = 1 + ((y + 1 + color) & 1);
+
+		kernels.relaxRow(row, up, down, prevRow, a, cRecip, xStart, size - 1);
+	}
+}
+
+void FluidBox::diffuse(Field2D &v, Field2D &vPrev, int b) {
 	float a = dt * diff * (size - 2) * (size - 2);
 	removeDivergence(v, vPrev, a, 1 + 4 * a, b);
 }
 
-void FluidBox::project(std::vector<std::vector<float>> &vx, std::vector<std::vector<float>> &vy, std::vector<std::vector<float>> &p, std::vector<std::vector<float>> &div) {
-	for (int y = 1; y < size - 1; y++) {
-		for (int x = 1; x < size - 1; x++) {
-			div[y][x] = -0.5f*(
-				  vx[y][x+1]
-				- vx[y][x-1]
-				+ vy[y+1][x]
-				- vy[y-1][x]
-				) / size;
-			p[y][x] = 0;
+// the last frame's pressure is left in "pressure" as the starting guess, it barely changes from one frame to the next
+// its outer ring is never written so it stays the zero boundary every backend expects
+void FluidBox::project(Field2D &vx, Field2D &vy, Field2D &div) {
+	Field2D &p = pressure;
+
+	threadPool->parallelFor(1, size - 1, [&](int yStart, int yEnd) {
+		for (int y = yStart; y < yEnd; y++) {
+			const float* vxRow = vx[y];
+			const float* vyUp = vy[y - 1];
+			const float* vyDown = vy[y + 1];
+			float* divRow = div[y];
+
+			kernels.divergenceRow(divRow, vxRow, vyUp, vyDown, size, 1, size - 1);
 		}
-	}
+	});
 
-	enforceBounds(p);
 	enforceBounds(div);
-	removeDivergence(p, div, 1, 4, 0);
+	{
+		TraceScope trace("pressure solve");
+		solvePressure(p, div);
+	}
+
+	threadPool->parallelFor(1, size - 1, [&](int yStart, int yEnd) {
+		for (int y = yStart; y < yEnd; y++) {
+			float* vxRow = vx[y];
+			float* vyRow = vy[y];
+			const float* pRow = p[y];
+			const float* pUp = p[y - 1];
+			const float* pDown = p[y + 1];
 
-	for (int y = 1; y < size - 1; y++) {
-		for (int x = 1; x < size - 1; x++) {
-			vx[y][x] -= 0.5f * (p[y][x+1] - p[y][x-1]) * size;
-			vy[y][x] -= 0.5f * (p[y+1][x] - p[y-1][x]) * size;
+			kernels.gradientRow(vxRow, vyRow, pRow, pUp, pDown, size, 1, size - 1);
 		}
-	}
+	});
 	enforceBounds(vx, 1);
 	enforceBounds(vy, 2);
 }
 
-void FluidBox::advect(int b, std::vector<std::vector<float>> &vx, std::vector<std::vector<float>> &vy, std::vector<std::vector<float>> &d, std::vector<std::vector<float>> &d0) {
-	float i0, i1, j0, j1;
+// solves 4p - (sum of neighbours) = div for the pressure with the selected backend
+void FluidBox::solvePressure(Field2D &p, Field2D &div) {
+	switch (pressureSolver) {
+	case PressureSolver::MULTIGRID:
+		multigrid.solve(p, div, multigridCycles, multigridCycle, threadPool);
+		enforceBounds(p, 0);
+
+		pressureIterations = multigridCycles;
+		pressureResidual = measurePressureResidual(p, div);
+		break;
+	case PressureSolver::CONJUGATE_GRADIENT:
+		pressureIterations = conjugateGradient.solve(p, div, pressureTolerance, pressureMaxIterations, threadPool, pressureResidual);
+		enforceBounds(p, 0);
+		break;
+	case PressureSolver::SPECTRAL:
+		spectralSolver.solve(p, div, threadPool);
+		enforceBounds(p, 0);
+
+		pressureIterations = 1;
+		pressureResidual = measurePressureResidual(p, div);
+		break;
+	default:
+		removeDivergence(p, div, 1, 4, 0);
+
+		pressureIterations = divIter;
+		pressureResidual = measurePressureResidual(p, div);
+		break;
+	}
+}
+
+// largest leftover of div - (4p - neighbours) over the interior
+float FluidBox::measurePressureResidual(Field2D &p, Field2D &div) {
+	vector<float> rowMax = vector<float>(size, 0);
+
+	threadPool->parallelFor(1, size - 1, [&](int yStart, int yEnd) {
+		for (int y = yStart; y < yEnd; y++) {
+			const float* up = p[y - 1];
+			const float* row = p[y];
+			const float* down = p[y + 1];
+			const float* divRow = div[y];
+
+			float largest = 0;
+			for (int x = 1; x < size - 1; x++) {
+				float r = divRow[x] - (4.0f * row[x] - up[x] - down[x] - row[x - 1] - row[x + 1]);
+				largest = std::max(largest, std::abs(r));
+			}
 
+			rowMax[y] = largest;
+		}
+	});
+
+	return *std::max_element(rowMax.begin(), rowMax.end());
+}
+
+void FluidBox::advect(int b, Field2D &vx, Field2D &vy, Field2D &d, Field2D &d0) {
+	vector<AdvectedField> fields = { AdvectedField(d, d0, b) };
+	advectFields(vx, vy, fields);
+}
+
+// semi-lagrangian advection of every field in fields by the same velocity
+// the backtrace (cell indices and bilinear weights) is worked out once per row and then applied to each field in turn
+void FluidBox::advectFields(Field2D &vx, Field2D &vy, vector<AdvectedField> &fields) {
 	float dtx = dt * (size - 2);
 	float dty = dt * (size - 2);
 
-	float s0, s1, t0, t1;
-
 	float Nfloat = size;
 
-	for (int j = 1; j < size - 1; j++) {
-		for (int i = 1; i < size - 1; i++) {
-			calcUpstreamCoords(Nfloat, vx[j][i], vy[j][i], dtx, dty, i, j, i0, i1, j0, j1, s0, s1, t0, t1);
+	threadPool->parallelFor(1, size - 1, [&](int jStart, int jEnd) {
+		float i0, i1, j0, j1;
+		float s0, s1, t0, t1;
+
+		vector<int> i0Row(size), i1Row(size), j0Row(size), j1Row(size);
+		vector<float> s0Row(size), s1Row(size), t0Row(size), t1Row(size);
+
+		for (int j = jStart; j < jEnd; j++) {
+			const float* vxRow = vx[j];
+			const float* vyRow = vy[j];
 
-			int i0i = int(i0);
-			int i1i = int(i1);
-			int j0i = int(j0);
-			int j1i = int(j1);
+			for (int i = 1; i < size - 1; i++) {
+				calcUpstreamCoords(Nfloat, vxRow[i], vyRow[i], dtx, dty, i, j, i0, i1, j0, j1, s0, s1, t0, t1);
 
-			constrain(i0i, 0, size - 1);
-			constrain(i1i, 0, size - 1);
-			constrain(j0i, 0, size - 1);
-			constrain(j1i, 0, size - 1);
+				int i0i = int(i0);
+				int i1i = int(i1);
+				int j0i = int(j0);
+				int j1i = int(j1);
 
-			d[j][i] =
-				s0 * (t0 * d0[j0i][i0i] + t1 * d0[j1i][i0i]) +
-				s1 * (t0 * d0[j0i][i1i] + t1 * d0[j1i][i1i]);
+				constrain(i0i, 0, size - 1);
+				constrain(i1i, 0, size - 1);
+				constrain(j0i, 0, size - 1);
+				constrain(j1i, 0, size - 1);
+
+				i0Row[i] = i0i;
+				i1Row[i] = i1i;
+				j0Row[i] = j0i;
+				j1Row[i] = j1i;
+
+				s0Row[i] = s0;
+				s1Row[i] = s1;
+				t0Row[i] = t0;
+				t1Row[i] = t1;
+			}
+
+			for (int f = 0; f < fields.size(); f++) {
+				Field2D &d0 = *fields[f].d0;
+				float* dRow = (*fields[f].d)[j];
+
+				for (int i = 1; i < size - 1; i++) {
+					const float* d0Row0 = d0[j0Row[i]];
+					const float* d0Row1 = d0[j1Row[i]];
+
+					dRow[i] =
+						s0Row[i] * (t0Row[i] * d0Row0[i0Row[i]] + t1Row[i] * d0Row1[i0Row[i]]) +
+						s1Row[i] * (t0Row[i] * d0Row0[i1Row[i]] + t1Row[i] * d0Row1[i1Row[i]]);
+				}
+			}
 		}
-	}
+	});
 
-	enforceBounds(d, b);
+	for (int f = 0; f < fields.size(); f++) {
+		enforceBounds(*fields[f].d, fields[f].b);
+	}
 }
 
 void FluidBox::updateTracers() {
@@ -290,9 +495,9 @@ void FluidBox::addDensity(glm::vec2 pos, float amount, glm::vec3 color) {
 		return;
 	}
 
-	density[0][pos.y][pos.x] += amount * color.x / 255.0f;
-	density[1][pos.y][pos.x] += amount * color.y / 255.0f;
-	density[2][pos.y][pos.x] += amount * color.z / 255.0f;
+	density[0].at(pos.x, pos.y) += amount * color.x / 255.0f;
+	density[1].at(pos.x, pos.y) += amount * color.y / 255.0f;
+	density[2].at(pos.x, pos.y) += amount * color.z / 255.0f;
 }
 
 void FluidBox::addVelocity(glm::vec2 pos, glm::vec2 amount) {
@@ -300,8 +505,92 @@ void FluidBox::addVelocity(glm::vec2 pos, glm::vec2 amount) {
 		return;
 	}
 
-	velocity->getXList()[pos.y][pos.x] += amount.x;
-	velocity->getYList()[pos.y][pos.x] += amount.y;
+	velocity->getXList().at(pos.x, pos.y) += amount.x;
+	velocity->getYList().at(pos.x, pos.y) += amount.y;
+}
+
+// adds a round brush of density (with a little random variation) and velocity along dir centred on pos
+// the variation comes from the box's own generator so the same seed and strokes give the same result on every platform
+// dir is expected to be normalized, cells outside the interior are skipped
+void FluidBox::splat(glm::vec2 pos, glm::vec2 dir, int brushSize, float densityInc, float velocityInc, glm::vec3 color) {
+	if (brushSize <= 0) {
+		return;
+	}
+
+	const vector<int> &brush = getBrush(brushSize);
+	glm::vec2 push = velocityInc * dir;
+
+	float low = 1;
+	float high = size - 2;
+
+	// clip the brush square to the interior once, the circle is clipped to it row by row
+	int xLow = -brushSize;
+	while (xLow < brushSize && pos.x + xLow < low) {
+		xLow++;
+	}
+	int xHigh = brushSize;
+	while (xHigh > xLow && pos.x + (xHigh - 1) > high) {
+		xHigh--;
+	}
+
+	if (splatAmounts.size() < size_t(2 * brushSize)) {
+		splatAmounts.resize(2 * brushSize);
+	}
+
+	for (int y = -brushSize; y < brushSize; y++) {
+		float cy = pos.y + y;
+		if (cy < low || cy > high) {
+			continue;
+		}
+
+		int halfWidth = brush[y + brushSize];
+		int xStart = max(-halfWidth, xLow);
+		int xEnd = min(min(halfWidth + 1, brushSize), xHigh);
+		int count = xEnd - xStart;
+		if (count <= 0) {
+			continue;
+		}
+
+		int row = int(cy);
+		int column = int(pos.x + xStart);
+
+		// one jitter per cell in the same order as cell by cell, top 24 bits as a float in [0, 1)
+		// scaled to [0.25, 0.75) so strokes average half of densityInc, which is what the viewer always put down
+		// (rand() / INT_MAX + 0.5 is 0.5 wherever RAND_MAX is 32767)
+		for (int i = 0; i < count; i++) {
+			float jitter = float(random() >> 8) / float(1 << 24);
+			splatAmounts[i] = densityInc * (0.5f * jitter + 0.25f);
+		}
+
+		kernels.splatRow(density[0][row] + column, density[1][row] + column, density[2][row] + column, splatAmounts.data(), color.x, color.y, color.z, count);
+
+		if (!velocityFrozen) {
+			kernels.addRow(velocity->getXList()[row] + column, push.x, count);
+			kernels.addRow(velocity->getYList()[row] + column, push.y, count);
+		}
+	}
+}
+
+// the cells within brushSize of the centre over [-brushSize, brushSize) in both directions, built the first time a size is used
+// row y + brushSize covers x in [-halfWidth, halfWidth] (cut off at brushSize - 1)
+const vector<int>& FluidBox::getBrush(int brushSize) {
+	auto found = brushes.find(brushSize);
+	if (found != brushes.end()) {
+		return found->second;
+	}
+
+	vector<int> &brush = brushes[brushSize];
+	brush.resize(2 * brushSize);
+
+	for (int y = -brushSize; y < brushSize; y++) {
+		int halfWidth = 0;
+		while (glm::length(glm::vec2(halfWidth + 1, y)) <= brushSize) {
+			halfWidth++;
+		}
+		brush[y + brushSize] = halfWidth;
+	}
+
+	return brush;
 }
 
 void FluidBox::freezeVelocity()
@@ -320,45 +609,51 @@ bool FluidBox::getFreezeVelocity()
 }
 
 void FluidBox::clear() {
-	this->prevDensity = vector<vector<vector<float>>>(3, vector<vector<float>>(size, vector<float>(size, 0)));
-	this->density = vector<vector<vector<float>>>(3, vector<vector<float>>(size, vector<float>(size, 0)));
+	this->prevDensity = vector<Field2D>(3, Field2D(size, size, 0));
+	this->density = vector<Field2D>(3, Field2D(size, size, 0));
+	this->pressure = Field2D(size, size, 0);
 	this->tracers = vector<Tracer>();
+
+	delete this->velocityPrev;
+	delete this->velocity;
 	this->velocityPrev = new DynamicVector(size, size);
 	this->velocity = new DynamicVector(size, size);
 }
 
 void FluidBox::fadeDensity(float increment, float min, float max) {
-	int checkInterval = size / 60;
+	// grids under 60 cells across are sampled at every cell
+	int checkInterval = std::max(1, size / 60);
 	float densityMultiplier = 10.0f / 255.0f;
 
 	float avgDensity = 0;
+	int samples = 0;
 	for (int y = 0; y < size; y += checkInterval) {
 		for (int x = 0; x < size; x += checkInterval) {
 			for (int i = 0; i < density.size(); i++) {
 				avgDensity += density[i][y][x];
+				samples++;
 			}
 		}
 	}
-	avgDensity /= 3 * (size / checkInterval)*(size / checkInterval);
+	avgDensity /= samples;
 
 	float densityIncrement = increment * (avgDensity * densityMultiplier);
 
-	for (int y = 0; y < size; y++) {
-		for (int x = 0; x < size; x++) {
-			for (int i = 0; i < density.size(); i++) {
-				density[i][y][x] -= densityIncrement;
-				constrain(density[i][y][x], min, max);
+	threadPool->parallelFor(0, size, [&](int yStart, int yEnd) {
+		for (int i = 0; i < density.size(); i++) {
+			for (int y = yStart; y < yEnd; y++) {
+				kernels.fadeRow(density[i][y], densityIncrement, min, max, size);
 			}
 		}
-	}
+	});
 }
 
 glm::vec3 FluidBox::getColorAtPos(glm::vec2 pos) {
 	glm::vec3 output = glm::vec3(1);
 
-	output.x = density[0][pos.y][pos.x];
-	output.y = density[1][pos.y][pos.x];
-	output.z = density[2][pos.y][pos.x];
+	output.x = density[0].at(pos.x, pos.y);
+	output.y = density[1].at(pos.x, pos.y);
+	output.z = density[2].at(pos.x, pos.y);
 	
 	return output;
 }
@@ -9,21 +9,31 @@
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtx/string_cast.hpp>
 
+#include <random>
+#include <unordered_map>
 #include <vector>
 
+#include "ConjugateGradient.h"
+#include "Field2D.h"
+#include "Multigrid.h"
+#include "Profiler.h"
+#include "SpectralSolver.h"
+#include "StencilKernels.h"
+#include "ThreadPool.h"
+
 struct DynamicVector {
 	// (access dim, y, x)
-	std::vector<std::vector<std::vector<float>>> vector;
+	std::vector<Field2D> vector;
 
 	DynamicVector(int x_size, int y_size, float default_value = 0) {
-		vector = std::vector<std::vector<std::vector<float>>>(2, std::vector<std::vector<float>>(y_size, std::vector<float>(x_size, default_value)));
+		vector = std::vector<Field2D>(2, Field2D(x_size, y_size, default_value));
 	}
 
-	std::vector<std::vector<float>> &getXList() {
+	Field2D &getXList() {
 		return vector[0];
 	}
 
-	std::vector<std::vector<float>> &getYList() {
+	Field2D &getYList() {
 		return vector[1];
 	}
 
@@ -49,6 +59,30 @@ struct Tracer {
 	}
 };
 
+// one field moved by advectFields, d is filled from d0 and b is the boundary type passed to enforceBounds
+struct AdvectedField {
+	Field2D* d;
+	Field2D* d0;
+	int b;
+
+	AdvectedField(Field2D &d, Field2D &d0, int b) {
+		this->d = &d;
+		this->d0 = &d0;
+		this->b = b;
+	}
+};
+
+// how removeDivergence relaxes its grid
+// GAUSS_SEIDEL sweeps row by row in place on one thread
+// RED_BLACK_GAUSS_SEIDEL updates the checkerboard colours one after the other so each colour can be split across threads
+enum SolverMode { GAUSS_SEIDEL = 0, RED_BLACK_GAUSS_SEIDEL = 1 };
+
+// which backend project uses to solve for pressure
+// RELAXATION runs removeDivergence for divIter iterations, MULTIGRID runs multigridCycles multigrid cycles
+// CONJUGATE_GRADIENT iterates until the residual drops to pressureTolerance (or pressureMaxIterations is hit)
+// SPECTRAL solves the problem directly with sine transforms in one pass
+enum PressureSolver { RELAXATION = 0, MULTIGRID = 1, CONJUGATE_GRADIENT = 2, SPECTRAL = 3 };
+
 class FluidBox {
 public:
 	// settings
@@ -62,11 +96,23 @@ public:
 
 	bool velocityFrozen;
 
+	SolverMode solverMode;
+
+	PressureSolver pressureSolver;
+	int multigridCycles;
+	MultigridCycle multigridCycle;
+	float pressureTolerance;
+	int pressureMaxIterations;
+
+	// how converged the last pressure solve was (largest remaining residual) and how many iterations it took
+	float pressureResidual;
+	int pressureIterations;
+
 	// runtime vars
 	// density (one is the previous stored value and the other is the current value)
 	// First dimension refers to rgb
-	std::vector<std::vector<std::vector<float>>> prevDensity;
-	std::vector<std::vector<std::vector<float>>> density;
+	std::vector<Field2D> prevDensity;
+	std::vector<Field2D> density;
 
 	// Color Tracers (Each array contains the rgb float values "0-255")
 	std::vector<Tracer> tracers;
@@ -75,18 +121,58 @@ public:
 	DynamicVector* velocityPrev;
 	DynamicVector* velocity;
 
+	// pressure from the last projection, kept as the initial guess for the next one
+	Field2D pressure;
+
+	// drives the brush jitter, seeded so a recorded run replays exactly
+	std::mt19937 random;
+
+	// the circle of each brush radius splat has used, as the half width of each of its rows (top to bottom)
+	std::unordered_map<int, std::vector<int>> brushes;
+	// density added to each cell of the row being splatted
+	std::vector<float> splatAmounts;
+
+	// workers shared by every parallel kernel
+	ThreadPool* threadPool;
+
+	// simd row kernels for the relaxation, projection and fade loops
+	StencilKernels kernels;
+
+	// grid hierarchy for the multigrid pressure solve (rebuilt whenever the size changes)
+	Multigrid multigrid;
+	ConjugateGradient conjugateGradient;
+	SpectralSolver spectralSolver;
+
+	// rolling timings of each phase of update (the viewer adds its own frame phases to it too)
+	Profiler profiler;
+	int velocityDiffusePhase;
+	int velocityAdvectPhase;
+	int projectPhase;
+	int densityDiffusePhase;
+	int densityAdvectPhase;
+	int tracersPhase;
+
 	FluidBox(int size, float diffusion, float viscosity, float dt);
+	~FluidBox();
+
+	void setThreadCount(int threadCount);
+	void seedRandom(unsigned int seed);
 
 	void update();
 
 	void resetSize(int size);
 
-	void enforceBounds(std::vector<std::vector<float>> &v, int dim = 1);
-	void removeDivergence(std::vector<std::vector<float>> &v, std::vector<std::vector<float>> &vPrev, float a, float c, int b);
+	void enforceBounds(Field2D &v, int dim = 1);
+	void removeDivergence(Field2D &v, Field2D &vPrev, float a, float c, int b);
+	void removeDivergenceRedBlack(Field2D &v, Field2D &vPrev, float a, float c, int b);
+	void relaxRedBlackRows(Field2D &v, Field2D &vPrev, float a, float cRecip, int color, int yStart, int yEnd);
 
-	void diffuse(std::vector<std::vector<float>> &v, std::vector<std::vector<float>> &vPrev, int b);
-	void project(std::vector<std::vector<float>> &vx, std::vector<std::vector<float>> &vy, std::vector<std::vector<float>> &p, std::vector<std::vector<float>> &div);
-	void advect(int b, std::vector<std::vector<float>> &vx, std::vector<std::vector<float>> &vy, std::vector<std::vector<float>> &d, std::vector<std::vector<float>> &d0);
+	void diffuse(Field2D &v, Field2D &vPrev, int b);
+	void project(Field2D &vx, Field2D &vy, Field2D &div);
+	void solvePressure(Field2D &p, Field2D &div);
+	float measurePressureResidual(Field2D &p, Field2D &div);
+	void advect(int b, Field2D &vx, Field2D &vy, Field2D &d, Field2D &d0);
+	void advectFields(Field2D &vx, Field2D &vy, std::vector<AdvectedField> &fields);
 
 	void updateTracers();
 
@@ -97,6 +183,8 @@ public:
 	void addTracer(glm::vec2 pos, glm::vec3 color);
 	void addDensity(glm::vec2 pos, float amount, glm::vec3 color = glm::vec3(1.0f));
 	void addVelocity(glm::vec2 pos, glm::vec2 amount);
+	void splat(glm::vec2 pos, glm::vec2 dir, int brushSize, float densityInc, float velocityInc, glm::vec3 color);
+	const std::vector<int>& getBrush(int brushSize);
 
 	void freezeVelocity();
 	void unfreezeVelocity();
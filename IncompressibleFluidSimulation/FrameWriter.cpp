@@ -0,0 +1,203 @@
+#include "FrameWriter.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+
+using namespace std;
+
+static const char MAGIC[8] = { 'F', 'S', 'F', 'R', 'A', 'M', 'E', 'S' };
+static const unsigned int VERSION = 1;
+
+// how long the writer sleeps before checking the queue again if it missed a wake up
+static const chrono::milliseconds POLL_INTERVAL(10);
+
+static unsigned char toByte(float value) {
+	return (unsigned char)(max(0.0f, min(255.0f, value)) + 0.5f);
+}
+
+FrameWriter::FrameWriter() : filledFrames(POOL_SIZE), freeFrames(POOL_SIZE) {
+	format = FLOAT_FRAMES;
+	size = 0;
+	channels = 3;
+	stopping.store(false);
+	writtenFrames.store(0);
+	droppedFrames = 0;
+}
+
+FrameWriter::~FrameWriter() {
+	stop();
+}
+
+bool FrameWriter::start(string path, FrameFormat format, bool includeVelocity, FluidBox &fluid) {
+	stop();
+
+	file.open(path, ios::binary);
+	if (!file) {
+		file.clear();
+		return false;
+	}
+
+	this->format = format;
+	size = fluid.size;
+	channels = includeVelocity && format == FLOAT_FRAMES ? 5 : 3;
+
+	if (format == Y4M_FRAMES) {
+		// 60 frames a second like the viewer, square pixels, full resolution chroma, full range samples
+		file << "YUV4MPEG2 W" << size << " H" << size << " F60:1 Ip A1:1 C444 XCOLORRANGE=FULL\n";
+	}
+	else {
+		FrameFileHeader header;
+		memcpy(header.magic, MAGIC, sizeof(MAGIC));
+		header.version = VERSION;
+		header.width = size;
+		header.height = size;
+		header.channels = channels;
+		header.bytesPerChannel = format == FLOAT_FRAMES ? 4 : 1;
+		header.frameCount = 0;
+		file.write((const char*)&header, sizeof(header));
+	}
+
+	// every buffer starts out free
+	pool = vector<Frame>(POOL_SIZE);
+	Frame* frame;
+	while (filledFrames.pop(frame)) {}
+	while (freeFrames.pop(frame)) {}
+	for (int i = 0; i < POOL_SIZE; i++) {
+		pool[i].data = vector<float>(size_t(size) * size * channels);
+		freeFrames.push(&pool[i]);
+	}
+
+	writtenFrames.store(0);
+	droppedFrames = 0;
+	stopping.store(false);
+
+	writer = thread(&FrameWriter::writerLoop, this);
+
+	return true;
+}
+
+void FrameWriter::stop() {
+	if (!writer.joinable()) {
+		return;
+	}
+
+	stopping.store(true);
+	wake.notify_one();
+	writer.join();
+
+	// the container says how many frames made it
+	if (format != Y4M_FRAMES) {
+		unsigned int frameCount = writtenFrames.load();
+		file.seekp(offsetof(FrameFileHeader, frameCount));
+		file.write((const char*)&frameCount, sizeof(frameCount));
+	}
+
+	file.close();
+
+	pool.clear();
+}
+
+bool FrameWriter::isCapturing() {
+	return writer.joinable();
+}
+
+void FrameWriter::capture(FluidBox &fluid) {
+	if (!isCapturing()) {
+		return;
+	}
+
+	// a resized grid doesn't fit in the stream any more
+	if (fluid.size != size) {
+		droppedFrames++;
+		return;
+	}
+
+	Frame* frame;
+	if (!freeFrames.pop(frame)) {
+		droppedFrames++;
+		return;
+	}
+
+	// only the cells, the padding at the end of each row is left behind
+	float* out = frame->data.data();
+	for (int c = 0; c < channels; c++) {
+		Field2D &field = c < 3 ? fluid.density[c] : (c == 3 ? fluid.velocity->getXList() : fluid.velocity->getYList());
+		for (int y = 0; y < size; y++) {
+			memcpy(out, field[y], size * sizeof(float));
+			out += size;
+		}
+	}
+
+	filledFrames.push(frame);
+	wake.notify_one();
+}
+
+unsigned int FrameWriter::getWrittenFrames() {
+	return writtenFrames.load();
+}
+
+unsigned int FrameWriter::getDroppedFrames() {
+	return droppedFrames;
+}
+
+void FrameWriter::writerLoop() {
+	while (true) {
+		Frame* frame;
+		if (filledFrames.pop(frame)) {
+			writeFrame(*frame);
+			freeFrames.push(frame);
+			writtenFrames.fetch_add(1);
+			continue;
+		}
+
+		// everything queued before stop has been written
+		if (stopping.load()) {
+			file.flush();
+			return;
+		}
+
+		unique_lock<std::mutex> lock(sleepMutex);
+		wake.wait_for(lock, POLL_INTERVAL);
+	}
+}
+
+void FrameWriter::writeFrame(Frame &frame) {
+	size_t cells = size_t(size) * size;
+
+	if (format == FLOAT_FRAMES) {
+		file.write((const char*)frame.data.data(), frame.data.size() * sizeof(float));
+		return;
+	}
+
+	bytes.resize(cells * 3);
+
+	const float* red = frame.data.data();
+	const float* green = red + cells;
+	const float* blue = green + cells;
+
+	if (format == RGB8_FRAMES) {
+		for (size_t i = 0; i < cells; i++) {
+			bytes[i] = toByte(red[i]);
+			bytes[cells + i] = toByte(green[i]);
+			bytes[2 * cells + i] = toByte(blue[i]);
+		}
+	}
+	else {
+		// full range bt.601
+		for (size_t i = 0; i < cells; i++) {
+			float r = max(0.0f, min(255.0f, red[i]));
+			float g = max(0.0f, min(255.0f, green[i]));
+			float b = max(0.0f, min(255.0f, blue[i]));
+
+			bytes[i] = toByte(0.299f * r + 0.587f * g + 0.114f * b);
+			bytes[cells + i] = toByte(128.0f - 0.168736f * r - 0.331264f * g + 0.5f * b);
+			bytes[2 * cells + i] = toByte(128.0f + 0.5f * r - 0.418688f * g - 0.081312f * b);
+		}
+
+		file << "FRAME\n";
+	}
+
+	file.write((const char*)bytes.data(), bytes.size());
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "FluidBox.h"
+#include "SpscQueue.h"
+
+// FLOAT_FRAMES and RGB8_FRAMES write a small container: a FrameFileHeader followed by frameCount frames, each frame
+// holds its channels one after the other (r, g, b and then vx, vy if velocity is captured) as size * size rows.
+// Y4M_FRAMES writes a YUV4MPEG2 stream (4:4:4) of the density that video tools read directly.
+enum FrameFormat { FLOAT_FRAMES = 0, RGB8_FRAMES = 1, Y4M_FRAMES = 2 };
+
+struct FrameFileHeader {
+	char magic[8];
+	unsigned int version;
+	int width;
+	int height;
+	// 3 for density only, 5 with velocity
+	int channels;
+	// 4 for floats, 1 for 8 bit
+	int bytesPerChannel;
+	// filled in when the capture stops
+	unsigned int frameCount;
+};
+
+// Streams the frames the sim produces to disk on its own thread so the frame loop never waits on the disk.
+// capture copies the fields into a buffer from a small pool and hands it to the writer through a lock-free queue,
+// the writer converts and writes it then hands the buffer back through a second queue.
+// When the writer falls far enough behind that the pool runs dry the frame is dropped (and counted) instead of waiting.
+class FrameWriter {
+public:
+	static const int POOL_SIZE = 8;
+
+	FrameWriter();
+	~FrameWriter();
+
+	// velocity is only written in FLOAT_FRAMES, returns false if the file can't be opened
+	bool start(std::string path, FrameFormat format, bool includeVelocity, FluidBox &fluid);
+
+	// waits for the queued frames to be written and closes the file
+	void stop();
+
+	bool isCapturing();
+
+	// called from the sim thread after each update
+	void capture(FluidBox &fluid);
+
+	unsigned int getWrittenFrames();
+	unsigned int getDroppedFrames();
+
+private:
+	struct Frame {
+		std::vector<float> data;
+	};
+
+	FrameFormat format;
+	int size;
+	int channels;
+
+	std::ofstream file;
+
+	std::vector<Frame> pool;
+	SpscQueue<Frame*> filledFrames;
+	SpscQueue<Frame*> freeFrames;
+
+	std::thread writer;
+	std::atomic<bool> stopping;
+	std::mutex sleepMutex;
+	std::condition_variable wake;
+
+	std::atomic<unsigned int> writtenFrames;
+	unsigned int droppedFrames;
+
+	// reused by the writer for the 8 bit conversions
+	std::vector<unsigned char> bytes;
+
+	void writerLoop();
+	void writeFrame(Frame &frame);
+};
@@ -0,0 +1,512 @@
+// Runs the simulation without a window, driven by a script of commands.
+// usage: FluidSimHeadless [script | -] [--timings file.csv] [--trace file.json]
+// with no script a short built in demo runs, "-" reads the script from stdin
+//
+// script commands (one per line, # starts a comment):
+//   size #                                     resize the grid
+//   set dt|visc|diff|iter|tol|maxiter|threads #
+//   set solver gs|rbgs
+//   set pressure relax|mg|pcg|fft
+//   set mg vcycle|fcycle
+//   set mg cycles #
+//   set simd scalar|avx2|avx512
+//   splat x y dx dy [radius density velocity r g b]    brush stroke before the next frame only
+//   source x y dx dy [radius density velocity r g b]   brush stroke before every frame from now on
+//   clear sources
+//   freeze velocity / unfreeze velocity
+//   clear                                      empties the grid
+//   step #                                     runs # frames
+//   write file.ppm                             saves the density as an image
+//   save file.ckpt                             checkpoints the whole state
+//   load file.ckpt                             restores a checkpoint (from here or the viewer's "save")
+//   capture start file [raw|rgb8|y4m] [velocity]  streams every following frame to file
+//   capture stop
+//   replay file.rec                            runs every frame of a recording made with "record start"
+//   record start file.rec / record stop        clears the grid and records the following frames for replay
+//   expect residual below #.#                  fails the script unless the last pressure solve got that close
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <stdexcept>
+
+#include <glm/glm.hpp>
+
+#include "Checkpoint.h"
+#include "FluidBox.h"
+#include "FrameWriter.h"
+#include "InputRecording.h"
+
+using namespace std;
+
+// one brush stroke, same parameters the viewer's mouse swipe uses
+struct Splat {
+	glm::vec2 pos;
+	glm::vec2 dir;
+	int radius;
+	float density;
+	float velocity;
+	glm::vec3 color;
+};
+
+struct FrameTiming {
+	double milliseconds;
+	int pressureIterations;
+	float pressureResidual;
+};
+
+static const char* DEMO_SCRIPT =
+	"size 150\n"
+	"source 37 75 1 0.3 10 20 0.05 255 128 30\n"
+	"step 100\n";
+
+FluidBox* fluid;
+FrameWriter frameWriter;
+InputRecorder inputRecorder;
+vector<Splat> pendingSplats;
+vector<Splat> sources;
+vector<FrameTiming> timings;
+
+void applySplat(Splat &splat) {
+	// same limits the viewer puts on mouse input
+	float density = std::max(0.0f, std::min(50.0f, splat.density));
+	float velocity = std::max(0.0f, std::min(0.15f, splat.velocity));
+
+	glm::vec2 dir = splat.dir;
+	if (glm::length(dir) > 0) {
+		dir = glm::normalize(dir);
+	}
+
+	inputRecorder.recordSplat(splat.pos, dir, splat.radius, density, velocity, splat.color);
+	fluid->splat(splat.pos, dir, splat.radius, density, velocity, splat.color);
+}
+
+bool processLine(string line);
+
+// one frame the same way the viewer runs it, a replay supplies the frame's recorded input on top of the script's
+void step(InputReplay* replay = nullptr) {
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+	bool paused = false;
+	{
+		TraceScope trace("splats");
+		if (replay != nullptr) {
+			// viewer only settings (colors, blur, tracers) don't mean anything here and are skipped
+			paused = replay->nextFrame(*fluid, [](string command) {
+				try {
+					processLine(command);
+				}
+				catch (std::exception &) {
+				}
+			});
+		}
+
+		for (int i = 0; i < sources.size(); i++) {
+			applySplat(sources[i]);
+		}
+		for (int i = 0; i < pendingSplats.size(); i++) {
+			applySplat(pendingSplats[i]);
+		}
+		pendingSplats.clear();
+	}
+
+	if (!paused) {
+		fluid->update();
+
+		{
+			TraceScope trace("fadeDensity");
+			fluid->fadeDensity(0.05f, 0, 255);
+		}
+
+		TraceScope trace("capture");
+		frameWriter.capture(*fluid);
+	}
+
+	inputRecorder.endFrame();
+
+	chrono::steady_clock::time_point end = chrono::steady_clock::now();
+
+	if (traceRecorder.isRecording()) {
+		traceRecorder.addSpan("frame", start, end);
+	}
+
+	FrameTiming timing;
+	timing.milliseconds = chrono::duration<double, milli>(end - start).count();
+	timing.pressureIterations = fluid->pressureIterations;
+	timing.pressureResidual = fluid->pressureResidual;
+	timings.push_back(timing);
+}
+
+bool writePPM(string path) {
+	ofstream file(path, ios::binary);
+	if (!file) {
+		return false;
+	}
+
+	file << "P6\n" << fluid->size << " " << fluid->size << "\n255\n";
+
+	vector<unsigned char> row(fluid->size * 3);
+	for (int y = 0; y < fluid->size; y++) {
+		for (int x = 0; x < fluid->size; x++) {
+			for (int c = 0; c < 3; c++) {
+				float value = std::max(0.0f, std::min(255.0f, fluid->density[c][y][x]));
+				row[x * 3 + c] = (unsigned char)(value + 0.5f);
+			}
+		}
+		file.write((const char*)row.data(), row.size());
+	}
+
+	return bool(file);
+}
+
+bool parseSplat(vector<string> &words, Splat &splat) {
+	if (words.size() < 5) {
+		return false;
+	}
+
+	splat.radius = 10;
+	splat.density = 20;
+	splat.velocity = 0.05f;
+	splat.color = glm::vec3(255);
+
+	splat.pos = glm::vec2(stof(words[1]), stof(words[2]));
+	splat.dir = glm::vec2(stof(words[3]), stof(words[4]));
+
+	if (words.size() > 5) splat.radius = stoi(words[5]);
+	if (words.size() > 6) splat.density = stof(words[6]);
+	if (words.size() > 7) splat.velocity = stof(words[7]);
+	if (words.size() > 10) splat.color = glm::vec3(stof(words[8]), stof(words[9]), stof(words[10]));
+
+	return true;
+}
+
+bool processSet(vector<string> &words) {
+	if (words.size() < 3) {
+		return false;
+	}
+
+	string name = words[1];
+	string value = words[2];
+
+	// the long names are the viewer's, recordings keep commands the way they were typed
+	if (name == "res" || name == "resolution") fluid->resetSize(std::max(8, stoi(value)));
+	else if (name == "dt") fluid->dt = stof(value);
+	else if (name == "visc" || name == "viscosity") fluid->visc = stof(value);
+	else if (name == "diff" || name == "diffusion") fluid->diff = stof(value);
+	else if (name == "iter" || name == "div_iter") fluid->divIter = stoi(value);
+	else if (name == "tol" || name == "tolerance") fluid->pressureTolerance = stof(value);
+	else if (name == "maxiter") fluid->pressureMaxIterations = std::max(1, stoi(value));
+	else if (name == "threads") fluid->setThreadCount(std::max(0, stoi(value)));
+	else if (name == "solver") {
+		if (value == "gs") fluid->solverMode = SolverMode::GAUSS_SEIDEL;
+		else if (value == "rbgs") fluid->solverMode = SolverMode::RED_BLACK_GAUSS_SEIDEL;
+		else return false;
+	}
+	else if (name == "pressure") {
+		if (value == "relax") fluid->pressureSolver = PressureSolver::RELAXATION;
+		else if (value == "mg" || value == "multigrid") fluid->pressureSolver = PressureSolver::MULTIGRID;
+		else if (value == "pcg") fluid->pressureSolver = PressureSolver::CONJUGATE_GRADIENT;
+		else if (value == "fft") fluid->pressureSolver = PressureSolver::SPECTRAL;
+		else return false;
+	}
+	else if (name == "mg" || name == "multigrid") {
+		if (value == "vcycle") fluid->multigridCycle = MultigridCycle::V_CYCLE;
+		else if (value == "fcycle") fluid->multigridCycle = MultigridCycle::F_CYCLE;
+		else if (value == "cycles" && words.size() > 3) fluid->multigridCycles = std::max(1, stoi(words[3]));
+		else return false;
+	}
+	else if (name == "simd") {
+		SimdLevel level;
+		if (value == "scalar") level = SimdLevel::SCALAR;
+		else if (value == "avx2") level = SimdLevel::AVX2;
+		else if (value == "avx512") level = SimdLevel::AVX512;
+		else return false;
+
+		if (!fluid->kernels.select(level)) {
+			cerr << "This cpu only supports up to " << StencilKernels::name(StencilKernels::detect()) << endl;
+		}
+	}
+	else return false;
+
+	return true;
+}
+
+bool processLine(string line) {
+	size_t comment = line.find('#');
+	if (comment != string::npos) {
+		line = line.substr(0, comment);
+	}
+
+	istringstream stream(line);
+	vector<string> words;
+	string word;
+	while (stream >> word) {
+		words.push_back(word);
+	}
+
+	if (words.empty()) {
+		return true;
+	}
+
+	string command = words[0];
+
+	// commands are recorded once they have run, the way the viewer records them
+	if (command == "size" && words.size() > 1) {
+		int size = std::max(8, stoi(words[1]));
+		fluid->resetSize(size);
+		// under the viewer's name so the recording replays there as well
+		inputRecorder.recordCommand("set res " + to_string(size));
+		return true;
+	}
+	if (command == "set") {
+		if (!processSet(words)) {
+			return false;
+		}
+		// threads and simd don't change the result, the viewer leaves them out too
+		if (words[1] != "threads" && words[1] != "simd") {
+			inputRecorder.recordCommand(line);
+		}
+		return true;
+	}
+	if (command == "splat" || command == "source") {
+		Splat splat;
+		if (!parseSplat(words, splat)) {
+			return false;
+		}
+		(command == "splat" ? pendingSplats : sources).push_back(splat);
+		return true;
+	}
+	if (command == "clear") {
+		if (words.size() > 1 && words[1] == "sources") {
+			sources.clear();
+		}
+		else {
+			fluid->clear();
+			inputRecorder.recordCommand(line);
+		}
+		return true;
+	}
+	if (command == "freeze" || command == "unfreeze") {
+		if (command == "freeze") {
+			fluid->freezeVelocity();
+		}
+		else {
+			fluid->unfreezeVelocity();
+		}
+		inputRecorder.recordCommand(line);
+		return true;
+	}
+	if (command == "step" && words.size() > 1) {
+		int frames = stoi(words[1]);
+		for (int i = 0; i < frames; i++) {
+			step();
+		}
+		return true;
+	}
+	if (command == "capture" && words.size() > 1) {
+		if (words[1] == "stop") {
+			frameWriter.stop();
+			return true;
+		}
+		if (words[1] != "start" || words.size() < 3) {
+			return false;
+		}
+
+		FrameFormat format = FrameFormat::FLOAT_FRAMES;
+		bool includeVelocity = false;
+		for (int i = 3; i < words.size(); i++) {
+			if (words[i] == "raw") format = FrameFormat::FLOAT_FRAMES;
+			else if (words[i] == "rgb8") format = FrameFormat::RGB8_FRAMES;
+			else if (words[i] == "y4m") format = FrameFormat::Y4M_FRAMES;
+			else if (words[i] == "velocity") includeVelocity = true;
+			else return false;
+		}
+
+		if (!frameWriter.start(words[2], format, includeVelocity, *fluid)) {
+			cerr << "Could not write " << words[2] << endl;
+			return false;
+		}
+		return true;
+	}
+	if ((command == "save" || command == "load") && words.size() > 1) {
+		string error;
+		bool ok = command == "save" ? saveCheckpoint(*fluid, words[1], error) : loadCheckpoint(*fluid, words[1], error);
+		if (!ok) {
+			cerr << "Could not " << command << ": " << error << endl;
+		}
+		return ok;
+	}
+	if (command == "replay" && words.size() > 1) {
+		InputReplay replay;
+		if (!replay.load(words[1])) {
+			cerr << "Could not read a recording from " << words[1] << endl;
+			return false;
+		}
+
+		replay.begin(*fluid);
+		while (replay.isPlaying()) {
+			step(&replay);
+		}
+		return true;
+	}
+	if (command == "record" && words.size() > 1) {
+		if (words[1] == "stop") {
+			inputRecorder.stop();
+			return true;
+		}
+		if (words[1] != "start" || words.size() < 3) {
+			return false;
+		}
+
+		if (!inputRecorder.start(words[2], *fluid)) {
+			cerr << "Could not write " << words[2] << endl;
+			return false;
+		}
+		return true;
+	}
+	if (command == "expect" && words.size() > 3 && words[1] == "residual" && words[2] == "below") {
+		if (!(fluid->pressureResidual < stof(words[3]))) {
+			cerr << "Pressure residual " << fluid->pressureResidual << " is not below " << words[3] << endl;
+			return false;
+		}
+		return true;
+	}
+	if (command == "write" && words.size() > 1) {
+		if (!writePPM(words[1])) {
+			cerr << "Could not write " << words[1] << endl;
+		}
+		return true;
+	}
+
+	return false;
+}
+
+void printSummary() {
+	if (timings.empty()) {
+		cout << "No frames were run" << endl;
+		return;
+	}
+
+	vector<double> times;
+	double total = 0;
+	long long pressureIterations = 0;
+	for (int i = 0; i < timings.size(); i++) {
+		times.push_back(timings[i].milliseconds);
+		total += timings[i].milliseconds;
+		pressureIterations += timings[i].pressureIterations;
+	}
+	sort(times.begin(), times.end());
+
+	double mean = total / times.size();
+
+	cout << "Grid: " << fluid->size << "x" << fluid->size << ", " << fluid->threadPool->getThreadCount() << " threads, simd " << StencilKernels::name(fluid->kernels.level) << endl;
+	cout << "Frames: " << times.size() << " in " << total << " ms (" << 1000.0 / mean << " frames/s)" << endl;
+	cout << "Frame time: mean " << mean << " ms, min " << times.front() << " ms, median " << times[times.size() / 2] << " ms, max " << times.back() << " ms" << endl;
+	cout << "Pressure: " << double(pressureIterations) / times.size() << " iterations per frame, last residual " << timings.back().pressureResidual << endl;
+	if (frameWriter.getWrittenFrames() > 0 || frameWriter.getDroppedFrames() > 0) {
+		cout << "Captured: " << frameWriter.getWrittenFrames() << " frames (" << frameWriter.getDroppedFrames() << " dropped)" << endl;
+	}
+	fluid->profiler.print(cout);
+}
+
+bool writeTimings(string path) {
+	ofstream file(path);
+	if (!file) {
+		return false;
+	}
+
+	file << "frame,milliseconds,pressure_iterations,pressure_residual\n";
+	for (int i = 0; i < timings.size(); i++) {
+		file << i << "," << timings[i].milliseconds << "," << timings[i].pressureIterations << "," << timings[i].pressureResidual << "\n";
+	}
+
+	return bool(file);
+}
+
+int main(int argc, char** argv) {
+	string scriptPath = "";
+	string timingsPath = "";
+	string tracePath = "";
+
+	for (int i = 1; i < argc; i++) {
+		string arg = argv[i];
+
+		if (arg == "--timings" && i + 1 < argc) {
+			timingsPath = argv[++i];
+		}
+		else if (arg == "--trace" && i + 1 < argc) {
+			tracePath = argv[++i];
+		}
+		else if (arg == "--help" || arg == "-h") {
+			cout << "usage: FluidSimHeadless [script | -] [--timings file.csv] [--trace file.json]" << endl;
+			return 0;
+		}
+		else {
+			scriptPath = arg;
+		}
+	}
+
+	// same settings the viewer starts with
+	fluid = new FluidBox(150, 0.0f, 0.0000001f, 0.4f);
+
+	istringstream demo(DEMO_SCRIPT);
+	ifstream scriptFile;
+	istream* script = &demo;
+
+	if (scriptPath == "-") {
+		script = &cin;
+	}
+	else if (scriptPath != "") {
+		scriptFile.open(scriptPath);
+		if (!scriptFile) {
+			cerr << "Could not open " << scriptPath << endl;
+			return 1;
+		}
+		script = &scriptFile;
+	}
+
+	if (tracePath != "") {
+		if (!traceRecorder.start(tracePath)) {
+			cerr << "Could not write " << tracePath << endl;
+			return 1;
+		}
+		traceRecorder.setThreadName("main");
+	}
+
+	string line;
+	int lineNumber = 0;
+	while (getline(*script, line)) {
+		lineNumber++;
+
+		bool ok;
+		try {
+			ok = processLine(line);
+		}
+		catch (std::exception &) {
+			ok = false;
+		}
+
+		if (!ok) {
+			cerr << "Line " << lineNumber << ": could not run \"" << line << "\"" << endl;
+			return 1;
+		}
+	}
+
+	traceRecorder.stop();
+	inputRecorder.stop();
+	frameWriter.stop();
+
+	printSummary();
+
+	if (timingsPath != "" && !writeTimings(timingsPath)) {
+		cerr << "Could not write " << timingsPath << endl;
+		return 1;
+	}
+
+	delete fluid;
+	return 0;
+}
@@ -0,0 +1,316 @@
+#include "InputRecording.h"
+
+#include <cstring>
+#include <random>
+
+using namespace std;
+
+static const char MAGIC[4] = { 'F', 'S', 'I', 'R' };
+static const unsigned int VERSION = 2;
+
+template <typename T>
+static void writeValue(ostream &out, const T &value) {
+	out.write((const char*)&value, sizeof(T));
+}
+
+template <typename T>
+static bool readValue(istream &in, T &value) {
+	return bool(in.read((char*)&value, sizeof(T)));
+}
+
+InputRecorder::InputRecorder() {
+	frame = 0;
+}
+
+InputRecorder::~InputRecorder() {
+	stop();
+}
+
+bool InputRecorder::start(string path, FluidBox &fluid) {
+	stop();
+
+	file.open(path, ios::binary);
+	if (!file) {
+		file.clear();
+		return false;
+	}
+
+	InputRecordingHeader header;
+	header.size = fluid.size;
+	header.dt = fluid.dt;
+	header.diff = fluid.diff;
+	header.visc = fluid.visc;
+	header.divIter = fluid.divIter;
+	header.solverMode = fluid.solverMode;
+	header.pressureSolver = fluid.pressureSolver;
+	header.multigridCycles = fluid.multigridCycles;
+	header.multigridCycle = fluid.multigridCycle;
+	header.pressureTolerance = fluid.pressureTolerance;
+	header.pressureMaxIterations = fluid.pressureMaxIterations;
+	header.seed = random_device()();
+
+	fluid.clear();
+	fluid.unfreezeVelocity();
+	fluid.seedRandom(header.seed);
+
+	file.write(MAGIC, sizeof(MAGIC));
+	writeValue(file, VERSION);
+	writeValue(file, header.size);
+	writeValue(file, header.dt);
+	writeValue(file, header.diff);
+	writeValue(file, header.visc);
+	writeValue(file, header.divIter);
+	writeValue(file, header.solverMode);
+	writeValue(file, header.pressureSolver);
+	writeValue(file, header.multigridCycles);
+	writeValue(file, header.multigridCycle);
+	writeValue(file, header.pressureTolerance);
+	writeValue(file, header.pressureMaxIterations);
+	writeValue(file, header.seed);
+
+	frame = 0;
+	origin = chrono::steady_clock::now();
+
+	return true;
+}
+
+void InputRecorder::stop() {
+	if (!file.is_open()) {
+		return;
+	}
+
+	writeEventStart(END_EVENT);
+	file.close();
+}
+
+bool InputRecorder::isRecording() {
+	return file.is_open();
+}
+
+void InputRecorder::recordSplat(glm::vec2 pos, glm::vec2 dir, int brushSize, float density, float velocity, glm::vec3 color) {
+	if (!isRecording()) {
+		return;
+	}
+
+	writeEventStart(SPLAT_EVENT);
+	writeValue(file, pos);
+	writeValue(file, dir);
+	writeValue(file, brushSize);
+	writeValue(file, density);
+	writeValue(file, velocity);
+	writeValue(file, color);
+}
+
+void InputRecorder::recordTracer(glm::vec2 pos, glm::vec3 color) {
+	if (!isRecording()) {
+		return;
+	}
+
+	writeEventStart(TRACER_EVENT);
+	writeValue(file, pos);
+	writeValue(file, color);
+}
+
+void InputRecorder::recordCommand(string command) {
+	if (!isRecording()) {
+		return;
+	}
+
+	writeEventStart(COMMAND_EVENT);
+	unsigned short length = (unsigned short)min(command.size(), size_t(0xFFFF));
+	writeValue(file, length);
+	file.write(command.data(), length);
+}
+
+void InputRecorder::recordPause() {
+	if (!isRecording()) {
+		return;
+	}
+
+	writeEventStart(PAUSE_EVENT);
+}
+
+void InputRecorder::endFrame() {
+	if (isRecording()) {
+		frame++;
+	}
+}
+
+unsigned int InputRecorder::getFrame() {
+	return frame;
+}
+
+void InputRecorder::writeEventStart(InputEventType type) {
+	float milliseconds = chrono::duration<float, milli>(chrono::steady_clock::now() - origin).count();
+
+	writeValue(file, (unsigned char)type);
+	writeValue(file, frame);
+	writeValue(file, milliseconds);
+}
+
+InputReplay::InputReplay() {
+	frameCount = 0;
+	playing = false;
+	frame = 0;
+	nextEvent = 0;
+}
+
+bool InputReplay::load(string path) {
+	ifstream file(path, ios::binary);
+	if (!file) {
+		return false;
+	}
+
+	char magic[4];
+	unsigned int version;
+	if (!file.read(magic, sizeof(magic)) || memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 || !readValue(file, version) || version != VERSION) {
+		return false;
+	}
+
+	InputRecordingHeader header;
+	bool ok = readValue(file, header.size) && readValue(file, header.dt) && readValue(file, header.diff) &&
+		readValue(file, header.visc) && readValue(file, header.divIter) && readValue(file, header.solverMode) &&
+		readValue(file, header.pressureSolver) && readValue(file, header.multigridCycles) &&
+		readValue(file, header.multigridCycle) && readValue(file, header.pressureTolerance) &&
+		readValue(file, header.pressureMaxIterations) && readValue(file, header.seed);
+	if (!ok || header.size < 8) {
+		return false;
+	}
+
+	vector<InputEvent> events;
+	unsigned int frameCount = 0;
+	bool ended = false;
+
+	unsigned char type;
+	while (!ended && readValue(file, type)) {
+		InputEvent event;
+		event.type = InputEventType(type);
+
+		if (!readValue(file, event.frame) || !readValue(file, event.milliseconds)) {
+			break;
+		}
+
+		bool complete = true;
+		switch (event.type) {
+		case SPLAT_EVENT:
+			complete = readValue(file, event.pos) && readValue(file, event.dir) && readValue(file, event.brushSize) &&
+				readValue(file, event.density) && readValue(file, event.velocity) && readValue(file, event.color);
+			break;
+		case TRACER_EVENT:
+			complete = readValue(file, event.pos) && readValue(file, event.color);
+			break;
+		case COMMAND_EVENT: {
+			unsigned short length;
+			complete = readValue(file, length);
+			if (complete) {
+				event.command = string(length, '\0');
+				complete = length == 0 || bool(file.read(&event.command[0], length));
+			}
+			break;
+		}
+		case PAUSE_EVENT:
+			break;
+		case END_EVENT:
+			ended = true;
+			break;
+		default:
+			return false;
+		}
+
+		// a recording cut off mid event (the program died while recording) keeps everything before it
+		if (!complete) {
+			break;
+		}
+
+		frameCount = max(frameCount, event.frame + (ended ? 0 : 1));
+
+		if (!ended) {
+			events.push_back(event);
+		}
+	}
+
+	this->header = header;
+	this->events = events;
+	this->frameCount = frameCount;
+	playing = false;
+
+	return true;
+}
+
+void InputReplay::begin(FluidBox &fluid) {
+	fluid.dt = header.dt;
+	fluid.diff = header.diff;
+	fluid.visc = header.visc;
+	fluid.divIter = header.divIter;
+	fluid.solverMode = SolverMode(header.solverMode);
+	fluid.pressureSolver = PressureSolver(header.pressureSolver);
+	fluid.multigridCycles = header.multigridCycles;
+	fluid.multigridCycle = MultigridCycle(header.multigridCycle);
+	fluid.pressureTolerance = header.pressureTolerance;
+	fluid.pressureMaxIterations = header.pressureMaxIterations;
+
+	if (fluid.size != header.size) {
+		fluid.resetSize(header.size);
+	}
+	fluid.clear();
+	fluid.unfreezeVelocity();
+	fluid.seedRandom(header.seed);
+
+	frame = 0;
+	nextEvent = 0;
+	playing = !isFinished();
+}
+
+bool InputReplay::isPlaying() {
+	return playing;
+}
+
+bool InputReplay::isFinished() {
+	return frame >= frameCount;
+}
+
+void InputReplay::stop() {
+	playing = false;
+}
+
+bool InputReplay::nextFrame(FluidBox &fluid, const function<void(string)> &runCommand) {
+	bool paused = false;
+
+	while (nextEvent < events.size() && events[nextEvent].frame == frame) {
+		InputEvent &event = events[nextEvent];
+
+		switch (event.type) {
+		case SPLAT_EVENT:
+			fluid.splat(event.pos, event.dir, event.brushSize, event.density, event.velocity, event.color);
+			break;
+		case TRACER_EVENT:
+			fluid.addTracer(event.pos, event.color);
+			break;
+		case COMMAND_EVENT:
+			runCommand(event.command);
+			break;
+		case PAUSE_EVENT:
+			paused = true;
+			break;
+		default:
+			break;
+		}
+
+		nextEvent++;
+	}
+
+	frame++;
+	if (isFinished()) {
+		playing = false;
+	}
+
+	return paused;
+}
+
+unsigned int InputReplay::getFrame() {
+	return frame;
+}
+
+unsigned int InputReplay::getFrameCount() {
+	return frameCount;
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <fstream>
+#include <functional>
+#include <string>
+#include <vector>
+#include <chrono>
+
+#include <glm/glm.hpp>
+
+#include "FluidBox.h"
+
+// Records everything the user does to the sim (brush strokes, tracers, commands and paused frames) per frame
+// into a small binary file, and plays such a file back frame by frame so the same workload can be rerun exactly.
+//
+// A recording starts from a cleared grid with unfrozen velocity, a fixed seed for the brush jitter and the settings in its header,
+// events are stored as the sim sees them (grid coordinates, after clamping) so playback doesn't depend on
+// the window size or on a window at all. Frames advance the sim by its fixed dt so playback speed doesn't matter.
+//
+// file layout (native byte order):
+//   header: "FSIR", version, size, dt, diff, visc, divIter, solverMode, pressureSolver, multigridCycles,
+//           multigridCycle, pressureTolerance, pressureMaxIterations, seed
+//   events: type (1 byte), frame, milliseconds since the recording started, then the payload of the type
+enum InputEventType { SPLAT_EVENT = 0, TRACER_EVENT = 1, COMMAND_EVENT = 2, PAUSE_EVENT = 3, END_EVENT = 4 };
+
+struct InputEvent {
+	InputEventType type;
+	unsigned int frame;
+	float milliseconds;
+
+	// SPLAT_EVENT and TRACER_EVENT
+	glm::vec2 pos;
+	glm::vec3 color;
+
+	// SPLAT_EVENT only
+	glm::vec2 dir;
+	int brushSize;
+	float density;
+	float velocity;
+
+	// COMMAND_EVENT
+	std::string command;
+};
+
+struct InputRecordingHeader {
+	int size;
+	float dt;
+	float diff;
+	float visc;
+	float divIter;
+	int solverMode;
+	int pressureSolver;
+	int multigridCycles;
+	int multigridCycle;
+	float pressureTolerance;
+	int pressureMaxIterations;
+	unsigned int seed;
+};
+
+class InputRecorder {
+public:
+	InputRecorder();
+	~InputRecorder();
+
+	// clears the fluid, seeds its brush jitter and starts writing to path, returns false if the file can't be opened
+	bool start(std::string path, FluidBox &fluid);
+	void stop();
+
+	bool isRecording();
+
+	// events are stamped with the frame they happen before the sim update of
+	void recordSplat(glm::vec2 pos, glm::vec2 dir, int brushSize, float density, float velocity, glm::vec3 color);
+	void recordTracer(glm::vec2 pos, glm::vec3 color);
+	void recordCommand(std::string command);
+	void recordPause();
+
+	// moves on to the next frame
+	void endFrame();
+
+	unsigned int getFrame();
+
+private:
+	std::ofstream file;
+	unsigned int frame;
+	std::chrono::steady_clock::time_point origin;
+
+	void writeEventStart(InputEventType type);
+};
+
+class InputReplay {
+public:
+	InputReplay();
+
+	// reads the whole recording into memory, returns false if it is missing or isn't a recording
+	bool load(std::string path);
+
+	// puts the fluid into the state the recording started from, the caller applies header.size to its own buffers first
+	void begin(FluidBox &fluid);
+
+	bool isPlaying();
+	bool isFinished();
+	void stop();
+
+	// applies the next frame's strokes and tracers to the fluid in the order they were recorded,
+	// commands are handed to runCommand (in order with the strokes), returns true if the frame was paused
+	bool nextFrame(FluidBox &fluid, const std::function<void(std::string)> &runCommand);
+
+	unsigned int getFrame();
+	unsigned int getFrameCount();
+
+	InputRecordingHeader header;
+
+private:
+	std::vector<InputEvent> events;
+	unsigned int frameCount;
+
+	bool playing;
+	unsigned int frame;
+	int nextEvent;
+};
@@ -7,8 +7,8 @@
 #include <shader.h>
 
 #include <tuple>
-#include <windows.h>
-#include <future>
+#include <algorithm>
+#include <atomic>
 #include <thread>
 #include <chrono>
 
@@ -18,7 +18,13 @@
 #include <glm/gtx/string_cast.hpp>
 
 #include "FluidBox.h"
+#include "Checkpoint.h"
+#include "DensityPacking.h"
+#include "FrameWriter.h"
+#include "InputRecording.h"
 #include "RenderObject.h"
+#include "SimulationThread.h"
+#include "SpscQueue.h"
 #include "BlurGL.h"
 #include "Quad.h"
 
@@ -26,7 +32,10 @@ using namespace std;
 
 // settings
 int resolution = 150;
+// sim steps per second, the solver advances at this rate whatever the display refreshes at
 double fps = 60;
+// most steps one frame runs to catch up, on a slower display the sim slows down instead of piling up work
+int maxStepsPerFrame = 4;
 
 // control settings
 bool enableTracers = false;
@@ -34,8 +43,15 @@ bool enableColor = true;
 bool enableBlur = true;
 int blurIterations = 10;
 
-string commandToRead;
-std::atomic<bool> enteredCommand;
+// what the density is sent to the gpu as
+TexelFormat texelFormat = FLOAT_TEXELS;
+
+// lines typed (or piped) into the console, pushed by the input thread and drained by the frame loop between sim steps.
+// never freed, the input thread can still be inside getline when main returns and statics are destroyed
+SpscQueue<string>& enteredCommands = *new SpscQueue<string>(256);
+
+// set when main is done, the input thread stops queueing anything after it
+std::atomic<bool> quitting(false);
 
 // status vars
 int SCR_HEIGHT;
@@ -141,14 +157,19 @@ bool processCommand(string command);
 // methods
 tuple<unsigned int, unsigned int> findWindowDims(float relativeScreenSize = 0.85, float aspectRatio = 1);
 void setupBlurFBO();
-void updateData(FluidBox &fluidBox, float* data);
-void updateBuffers(RenderObject* renderObject);
+void updateData(FluidBox &fluidBox, TexelFormat format, void* data);
+void stepSimulation(int steps, bool withPrevious, TexelFormat format, void* texels);
+int advanceClock(float &alpha);
+void processEnteredCommands();
+void commandInputThread();
 void processControls(GLFWwindow* window, FluidBox& fluid, ControlMode& controlMode);
 void updateForces(FluidBox& fluid);
 void incrementColorIndex();
 glm::vec2 getScalingVec();
 glm::vec3 getColorSpect(float n, float m);
 void containTracers(FluidBox& fluid, int min, int max);
+void replayFrame();
+void recordCommand(string command);
 bool constrain(glm::vec2& vec, float min, float max);
 void constrain(float &num, float min, float max);
 
@@ -161,6 +182,20 @@ GLFWwindow* window;
 FluidBox* fluid;
 RenderObject* renderFluid;
 
+// the sim steps frame N + 1 on its own thread while this thread draws frame N
+SimulationThread* simThread;
+
+// fixed step clock, real time that hasn't been simulated yet carries over to the next frame
+std::chrono::steady_clock::time_point lastFrameTime;
+double stepAccumulator;
+
+// whether the step posted last frame packs a new state into renderFluid, and the blend to draw it with
+bool pendingSnapshot;
+float pendingAlpha;
+
+// how far from the previous state to the current one the drawn frame is
+float drawAlpha;
+
 Shader renderToQuad;
 
 // fbo to give blur
@@ -187,8 +222,33 @@ int tracerRadius;
 // key trackers
 bool fPressed;
 
+// streams simulated frames to disk
+FrameWriter frameWriter;
+
+// input recording and playback
+InputRecorder inputRecorder;
+InputReplay inputReplay;
+std::chrono::steady_clock::time_point replayStart;
+
+// viewer phases timed into the sim's profiler next to its own
+int fadeDensityPhase;
+int updateDataPhase;
+int updateDataPreviousPhase;
+int updateBuffersPhase;
+int drawPhase;
+int framePhase;
+
 void setup() {
 	fluid = new FluidBox(resolution, 0.0f, 0.0000001f, 0.4f);
+
+	fadeDensityPhase = fluid->profiler.addPhase("fadeDensity");
+	updateDataPhase = fluid->profiler.addPhase("updateData");
+	// packing the previous step is timed apart so frames that blend don't add two updateData samples
+	updateDataPreviousPhase = fluid->profiler.addPhase("updateData previous");
+	updateBuffersPhase = fluid->profiler.addPhase("updateBuffers");
+	drawPhase = fluid->profiler.addPhase("drawToBlur / draw");
+	framePhase = fluid->profiler.addPhase("whole frame");
+
 	controlMode = ControlMode::MOUSE_SWIPE;
 	freeze = false;
 
@@ -203,9 +263,6 @@ void setup() {
 
 	mouse = MouseData();
 
-	commandToRead = "";
-	enteredCommand.store(false);
-
 	fPressed = false;
 
 	// init graphics stuff
@@ -248,11 +305,20 @@ void setup() {
 
 	// setup fluid render stuff
 	renderFluid = new RenderObject();
-	renderFluid->shader = Shader("resources/shaders/point_render.vs", "resources/shaders/point_render.fs", "resources/shaders/point_render.gs");
-	renderFluid->allocateMemory((resolution * resolution) * (2 + 3));
+	renderFluid->shader = Shader("resources/shaders/render_quad.vs", "resources/shaders/density_render.fs");
 
-	updateData(*fluid, renderFluid->data);
-	updateBuffers(renderFluid);
+	bool withPrevious = true;
+	void* texels = renderFluid->beginWrite(fluid->size, texelFormat, withPrevious);
+	stepSimulation(0, withPrevious, texelFormat, texels);
+	renderFluid->upload();
+
+	lastFrameTime = std::chrono::steady_clock::now();
+	stepAccumulator = 0;
+	pendingSnapshot = false;
+	pendingAlpha = 1;
+	drawAlpha = 1;
+
+	simThread = new SimulationThread();
 }
 
 void setupBlurFBO() {
@@ -268,11 +334,10 @@ void setupBlurFBO() {
 	glGenTextures(1, &toBlur);
 	glBindTexture(GL_TEXTURE_2D, toBlur);
 
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGB, GL_FLOAT, NULL);
-	//glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	//glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexImage2D(GL_TEXTURE_2D, 0, renderTargetFormat(texelFormat), SCR_WIDTH, SCR_HEIGHT, 0, GL_RGB, GL_FLOAT, NULL);
+	// both blurs read between texels to get two or four of them per fetch
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 	//glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
 	//glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
@@ -290,11 +355,17 @@ void draw() {
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 	renderFluid->shader.use();
-	renderFluid->shader.setFloat("sizeX", 2.0f / resolution);
-	renderFluid->shader.setFloat("sizeY", 2.0f / resolution);
+	renderFluid->shader.setInt("current", 0);
+	renderFluid->shader.setInt("previous", 1);
+	renderFluid->shader.setFloat("alpha", drawAlpha);
+
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, renderFluid->texture);
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D, renderFluid->previousTexture);
+	glActiveTexture(GL_TEXTURE0);
 
-	glBindVertexArray(renderFluid->VAO);
-	glDrawArrays(GL_POINTS, 0, resolution * resolution);
+	Quad::render();
 }
 
 void drawToBlur() {
@@ -303,6 +374,11 @@ void drawToBlur() {
 		setupBlurFBO();
 	}
 
+	// srgb targets store what's drawn into them encoded and hand back linear values, the window itself is left alone
+	if (texelFormat == SRGB8_TEXELS) {
+		glEnable(GL_FRAMEBUFFER_SRGB);
+	}
+
 	// draw original output
 	glBindFramebuffer(GL_FRAMEBUFFER, toBlurFBO);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -311,6 +387,8 @@ void drawToBlur() {
 
 	// blur
 	unsigned int blurredOutput = blur->process(SCR_WIDTH, SCR_HEIGHT, toBlur, blurIterations);
+
+	glDisable(GL_FRAMEBUFFER_SRGB);
 	
 	// render blurred output
 	glBindFramebuffer(GL_FRAMEBUFFER, 0);
@@ -329,42 +407,189 @@ void drawToBlur() {
 void updateFrame(FPSCounter& timer) {
 	timer.start();
 
-	processControls(window, *fluid, controlMode);
+	ScopedTimer frameTimer(fluid->profiler, framePhase);
 
-	// update frame
-	if (!freeze) {
-		fluid->update();
-		fluid->fadeDensity(0.05f, 0, 255);
+	// once the sim thread is done with the last frame the fluid is ours until the next one is posted
+	{
+		TraceScope trace("wait for sim");
+		simThread->wait();
 	}
 
-	updateData(*fluid, renderFluid->data);
-	updateBuffers(renderFluid);
+	// the state it packed gets drawn from now on, the copy into the textures happens on the gpu
+	if (pendingSnapshot) {
+		ScopedTimer buffersTimer(fluid->profiler, updateBuffersPhase);
+		renderFluid->upload();
+	}
+	drawAlpha = pendingAlpha;
 
-	//draw
-	if (enableBlur) {
-		drawToBlur();
+	{
+		TraceScope trace("input");
+		if (inputReplay.isPlaying()) {
+			replayFrame();
+		}
+		else {
+			processControls(window, *fluid, controlMode);
+		}
 	}
-	else {
-		draw();
+
+	processEnteredCommands();
+
+	float alpha;
+	int steps = advanceClock(alpha);
+
+	// a recorded frame is one step, input lands before the first step of the frame
+	// a frame that didn't step is kept as a pause so playback lines up step for step
+	if (steps == 0) {
+		inputRecorder.recordPause();
+	}
+	inputRecorder.endFrame();
+	for (int i = 1; i < steps; i++) {
+		inputRecorder.endFrame();
+	}
+
+	// step the sim and pack the result straight into the next pixel buffer, a paused sim is still packed so strokes show up
+	// the state before the last step only needs packing when there's more than one, otherwise it's the one drawn now
+	pendingSnapshot = steps > 0 || freeze;
+	pendingAlpha = alpha;
+	if (pendingSnapshot) {
+		bool withPrevious = steps > 1;
+		TexelFormat format = texelFormat;
+		void* texels = renderFluid->beginWrite(fluid->size, format, withPrevious);
+		simThread->post([steps, withPrevious, format, texels] {
+			stepSimulation(steps, withPrevious, format, texels);
+		});
+	}
+
+	// meanwhile draw the frame the sim finished last time
+	//draw
+	{
+		ScopedTimer drawTimer(fluid->profiler, drawPhase);
+		if (enableBlur) {
+			drawToBlur();
+		}
+		else {
+			draw();
+		}
 	}
 
 	mouse.update();
 
 	// update view
-	glfwSwapBuffers(window);
-	glfwPollEvents();
+	{
+		TraceScope trace("swap");
+		glfwSwapBuffers(window);
+	}
+	{
+		TraceScope trace("poll events");
+		glfwPollEvents();
+	}
 
 	timer.end();
 	//timer.printFPS(true);
 }
 
-// store the command input and then signal the main thread that we are complete and can exit the program
-string commandInputThread() {
-	std::cout << "Enter a command: ";
+// works out how many fixed steps the time since the last frame is worth, alpha is how far the leftover time
+// reaches into the next step
+int advanceClock(float &alpha) {
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	double elapsed = std::chrono::duration<double>(now - lastFrameTime).count();
+	lastFrameTime = now;
+
+	// paused time isn't owed afterwards, and a replay runs its recorded steps one per frame as fast as it's drawn
+	if (freeze || inputReplay.isPlaying()) {
+		stepAccumulator = 0;
+		alpha = 1;
+		return freeze ? 0 : 1;
+	}
+
+	double stepTime = 1.0 / fps;
+
+	stepAccumulator += elapsed;
+	int steps = int(stepAccumulator / stepTime);
+	stepAccumulator -= steps * stepTime;
+
+	// drop the time a slow display can't catch up on
+	if (steps > maxStepsPerFrame) {
+		steps = maxStepsPerFrame;
+	}
 
-	commandToRead = enterCommand();
-	enteredCommand.store(true);
-	return commandToRead;
+	alpha = float(stepAccumulator / stepTime);
+	return steps;
+}
+
+// runs on the sim thread, packs the state after the last step into texels and if withPrevious the one before it right after
+void stepSimulation(int steps, bool withPrevious, TexelFormat format, void* texels) {
+	void* previous = (char*)texels + size_t(fluid->size) * fluid->size * DENSITY_TEXEL_FLOATS * texelChannelBytes(format);
+
+	for (int i = 0; i < steps; i++) {
+		if (withPrevious && i == steps - 1) {
+			ScopedTimer dataTimer(fluid->profiler, updateDataPreviousPhase);
+			updateData(*fluid, format, previous);
+		}
+
+		fluid->update();
+
+		{
+			ScopedTimer fadeTimer(fluid->profiler, fadeDensityPhase);
+			fluid->fadeDensity(0.05f, 0, 255);
+		}
+
+		TraceScope trace("capture");
+		frameWriter.capture(*fluid);
+	}
+
+	{
+		ScopedTimer dataTimer(fluid->profiler, updateDataPhase);
+		updateData(*fluid, format, texels);
+	}
+
+	// the mapped buffer is only written, never read back, so the paused state is packed twice rather than copied
+	if (withPrevious && steps == 0) {
+		ScopedTimer dataTimer(fluid->profiler, updateDataPreviousPhase);
+		updateData(*fluid, format, previous);
+	}
+}
+
+// runs every command that came in since the last frame, only called while the sim thread is idle
+void processEnteredCommands() {
+	string command;
+	while (enteredCommands.pop(command)) {
+		TraceScope trace("command");
+
+		bool out = processCommand(command);
+		printProcessCommandResult(out);
+
+		if (out) {
+			recordCommand(command);
+		}
+	}
+}
+
+// reads the console for as long as the program runs and hands each line to the frame loop
+void commandInputThread() {
+	traceRecorder.setThreadName("command input");
+
+	while (true) {
+		std::cout << "Enter a command: ";
+
+		string command;
+		if (!std::getline(std::cin, command) || quitting.load()) {
+			// stdin closed (nothing more will come) or nobody is left to run it
+			return;
+		}
+
+		if (seperateStringBySpaces(command).size() == 0) {
+			continue;
+		}
+
+		// a script can get ahead of the frame loop, wait for it rather than lose commands
+		while (!enteredCommands.push(command)) {
+			if (quitting.load()) {
+				return;
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	}
 }
 
 int main() {
@@ -373,25 +598,25 @@ int main() {
 	timer = FPSCounter();
 	//frameLoopThread(timer);
 
-	future<string> commandInput = std::async(std::launch::async, commandInputThread);
+	traceRecorder.setThreadName("main");
+
+	// blocked in getline most of the time, it's left to end with the program once quitting is set
+	std::thread(commandInputThread).detach();
 
 	while (!glfwWindowShouldClose(window)) {
 		updateFrame(timer);
+	}
 
-		// if a command is sent then process, reset the command flag, and restart the async operation
-		if (enteredCommand.load()) {
-			bool out = processCommand(commandToRead);
-			printProcessCommandResult(out);
+	quitting.store(true);
 
-			// reset vals
-			commandToRead = "";
-			enteredCommand.store(false);
-			commandInput = std::async(std::launch::async, commandInputThread);
-		}
-	}
+	// lets the last step finish before anything it uses goes away
+	delete simThread;
+
+	traceRecorder.stop();
+	inputRecorder.stop();
+	frameWriter.stop();
 
 	glfwTerminate();
-	delete[] renderFluid->data;
 
 	return 0;
 }
@@ -405,24 +630,65 @@ void listAllCommands() {
 		"get fps" << std::endl <<
 		"get res" << std::endl <<
 		"get dt" << std::endl <<
+		"get rate" << std::endl <<
 		"get visc" << std::endl <<
 		"get diff" << std::endl <<
 		"get iter" << std::endl <<
+		"get threads" << std::endl <<
+		"get solver" << std::endl <<
+		"get pressure" << std::endl <<
+		"get tol" << std::endl <<
+		"get maxiter" << std::endl <<
+		"get residual" << std::endl <<
+		"get simd" << std::endl <<
 		"get blur" << std::endl <<
+		"get transfer" << std::endl <<
+		"get profile" << std::endl <<
 		"set tracers enabled" << std::endl <<
 		"set tracers disabled" << std::endl <<
 		"set colors enabled" << std::endl <<
 		"set colors disabled" << std::endl <<
 		"set blur enabled" << std::endl <<
 		"set blur disabled" << std::endl <<
+		"set blur gaussian" << std::endl <<
+		"set blur dual" << std::endl <<
 		"set res #" << std::endl <<
 		"set dt #.#" << std::endl <<
+		"set rate #" << std::endl <<
 		"set visc #.#" << std::endl <<
 		"set diff #.#" << std::endl <<
 		"set iter #" << std::endl <<
+		"set threads #" << std::endl <<
+		"set solver gs" << std::endl <<
+		"set solver rbgs" << std::endl <<
+		"set simd scalar" << std::endl <<
+		"set simd avx2" << std::endl <<
+		"set simd avx512" << std::endl <<
+		"set pressure relax" << std::endl <<
+		"set pressure mg" << std::endl <<
+		"set pressure pcg" << std::endl <<
+		"set pressure fft" << std::endl <<
+		"set tol #.#" << std::endl <<
+		"set maxiter #" << std::endl <<
+		"set mg vcycle" << std::endl <<
+		"set mg fcycle" << std::endl <<
+		"set mg cycles #" << std::endl <<
 		"set blur #" << std::endl <<
+		"set transfer float" << std::endl <<
+		"set transfer half" << std::endl <<
+		"set transfer srgb8" << std::endl <<
 		"freeze velocity" << std::endl <<
-		"unfreeze velocity" << std::endl;
+		"unfreeze velocity" << std::endl <<
+		"trace start <file>" << std::endl <<
+		"trace stop" << std::endl <<
+		"record start <file>" << std::endl <<
+		"record stop" << std::endl <<
+		"replay <file>" << std::endl <<
+		"replay stop" << std::endl <<
+		"save <file>" << std::endl <<
+		"load <file>" << std::endl <<
+		"capture start <file> [raw|rgb8|y4m] [velocity]" << std::endl <<
+		"capture stop" << std::endl;
 	std::cout << "--------------------" << std::endl;
 }
 
@@ -489,6 +755,14 @@ bool processCommand(string command) {
 						enableBlur = false;
 						return true;
 					}
+					if (list[2] == "gaussian") {
+						blur->mode = GAUSSIAN_BLUR;
+						return true;
+					}
+					if (list[2] == "dual") {
+						blur->mode = DUAL_BLUR;
+						return true;
+					}
 				}
 			}
 
@@ -507,8 +781,6 @@ bool processCommand(string command) {
 					resolution = num;
 					fluid->resetSize(resolution);
 
-					renderFluid->allocateMemory((resolution * resolution) * (2 + 3));
-
 					return true;
 				}
 			}
@@ -529,6 +801,26 @@ bool processCommand(string command) {
 				}
 			}
 
+			if (list[1] == "rate") {
+				if (list.size() > 2) {
+					float num;
+					try {
+						num = std::stof(list[2]);
+					}
+					catch (std::invalid_argument err) {
+						return false;
+					}
+
+					if (num <= 0) {
+						return false;
+					}
+
+					fps = num;
+
+					return true;
+				}
+			}
+
 			if (list[1] == "viscosity" || list[1] == "visc") {
 				if (list.size() > 2) {
 					float num;
@@ -577,6 +869,174 @@ bool processCommand(string command) {
 				}
 			}
 
+			if (list[1] == "threads") {
+				if (list.size() > 2) {
+					int num;
+					try {
+						num = std::stoi(list[2]);
+					}
+					catch (std::invalid_argument err) {
+						return false;
+					}
+
+					if (num < 0) {
+						return false;
+					}
+
+					fluid->setThreadCount(num);
+
+					return true;
+				}
+			}
+
+			if (list[1] == "solver") {
+				if (list.size() > 2) {
+					if (list[2] == "gs") {
+						fluid->solverMode = SolverMode::GAUSS_SEIDEL;
+						return true;
+					}
+					if (list[2] == "rbgs") {
+						fluid->solverMode = SolverMode::RED_BLACK_GAUSS_SEIDEL;
+						return true;
+					}
+				}
+			}
+
+			if (list[1] == "simd") {
+				if (list.size() > 2) {
+					SimdLevel level;
+					if (list[2] == "scalar") {
+						level = SimdLevel::SCALAR;
+					}
+					else if (list[2] == "avx2") {
+						level = SimdLevel::AVX2;
+					}
+					else if (list[2] == "avx512") {
+						level = SimdLevel::AVX512;
+					}
+					else {
+						return false;
+					}
+
+					if (!fluid->kernels.select(level)) {
+						std::cout << "This cpu only supports up to " << StencilKernels::name(StencilKernels::detect()) << std::endl;
+					}
+					return true;
+				}
+			}
+
+			if (list[1] == "transfer") {
+				if (list.size() > 2) {
+					TexelFormat format;
+					if (list[2] == "float") {
+						format = FLOAT_TEXELS;
+					}
+					else if (list[2] == "half") {
+						format = HALF_TEXELS;
+					}
+					else if (list[2] == "srgb8") {
+						format = SRGB8_TEXELS;
+					}
+					else {
+						return false;
+					}
+
+					// the density texture follows on the next packed frame, the render targets change now
+					texelFormat = format;
+					blur->setFormat(renderTargetFormat(texelFormat));
+					setupBlurFBO();
+
+					return true;
+				}
+			}
+
+			if (list[1] == "pressure") {
+				if (list.size() > 2) {
+					if (list[2] == "relax") {
+						fluid->pressureSolver = PressureSolver::RELAXATION;
+						return true;
+					}
+					if (list[2] == "multigrid" || list[2] == "mg") {
+						fluid->pressureSolver = PressureSolver::MULTIGRID;
+						return true;
+					}
+					if (list[2] == "pcg") {
+						fluid->pressureSolver = PressureSolver::CONJUGATE_GRADIENT;
+						return true;
+					}
+					if (list[2] == "fft") {
+						fluid->pressureSolver = PressureSolver::SPECTRAL;
+						return true;
+					}
+				}
+			}
+
+			if (list[1] == "tolerance" || list[1] == "tol") {
+				if (list.size() > 2) {
+					float num;
+					try {
+						num = std::stof(list[2]);
+					}
+					catch (std::invalid_argument err) {
+						return false;
+					}
+
+					if (num <= 0) {
+						return false;
+					}
+
+					fluid->pressureTolerance = num;
+
+					return true;
+				}
+			}
+
+			if (list[1] == "maxiter") {
+				if (list.size() > 2) {
+					int num;
+					try {
+						num = std::stoi(list[2]);
+					}
+					catch (std::invalid_argument err) {
+						return false;
+					}
+
+					if (num < 1) {
+						return false;
+					}
+
+					fluid->pressureMaxIterations = num;
+
+					return true;
+				}
+			}
+
+			if (list[1] == "multigrid" || list[1] == "mg") {
+				if (list.size() > 2) {
+					if (list[2] == "vcycle") {
+						fluid->multigridCycle = MultigridCycle::V_CYCLE;
+						return true;
+					}
+					if (list[2] == "fcycle") {
+						fluid->multigridCycle = MultigridCycle::F_CYCLE;
+						return true;
+					}
+					if (list[2] == "cycles" && list.size() > 3) {
+						int num;
+						try {
+							num = std::stoi(list[3]);
+						}
+						catch (std::invalid_argument err) {
+							return false;
+						}
+
+						fluid->multigridCycles = max(1, num);
+
+						return true;
+					}
+				}
+			}
+
 			if (list[1] == "blur") {
 				if (list.size() > 2) {
 					float num;
@@ -612,6 +1072,11 @@ bool processCommand(string command) {
 				return true;
 			}
 
+			if (list[1] == "rate") {
+				std::cout << "Rate: " << fps << " steps per second (at most " << maxStepsPerFrame << " per frame)" << std::endl;
+				return true;
+			}
+
 			if (list[1] == "viscosity" || list[1] == "visc") {
 				std::cout << "Viscosity: " << fluid->dt << std::endl;
 				return true;
@@ -627,8 +1092,72 @@ bool processCommand(string command) {
 				return true;
 			}
 
+			if (list[1] == "threads") {
+				std::cout << "Threads: " << fluid->threadPool->getThreadCount() << std::endl;
+				return true;
+			}
+
+			if (list[1] == "solver") {
+				if (fluid->solverMode == SolverMode::RED_BLACK_GAUSS_SEIDEL) {
+					std::cout << "Solver: rbgs (" << fluid->threadPool->getThreadCount() << " threads)" << std::endl;
+				}
+				else {
+					std::cout << "Solver: gs" << std::endl;
+				}
+				return true;
+			}
+
+			if (list[1] == "simd") {
+				std::cout << "SIMD: " << StencilKernels::name(fluid->kernels.level) << " (cpu supports " << StencilKernels::name(StencilKernels::detect()) << ")" << std::endl;
+				return true;
+			}
+
+			if (list[1] == "transfer") {
+				std::cout << "Transfer format: " << texelFormatName(texelFormat) << " (" << DENSITY_TEXEL_FLOATS * texelChannelBytes(texelFormat) << " bytes per cell, " << (renderFluid->isPersistent() ? "persistent mapped" : "orphaned") << " pixel buffers)" << std::endl;
+				return true;
+			}
+
+			if (list[1] == "pressure") {
+				if (fluid->pressureSolver == PressureSolver::MULTIGRID) {
+					std::cout << "Pressure Solver: mg (" << fluid->multigridCycles << (fluid->multigridCycle == MultigridCycle::F_CYCLE ? " F" : " V") << " cycles)" << std::endl;
+				}
+				else if (fluid->pressureSolver == PressureSolver::CONJUGATE_GRADIENT) {
+					std::cout << "Pressure Solver: pcg (tolerance " << fluid->pressureTolerance << ", at most " << fluid->pressureMaxIterations << " iterations)" << std::endl;
+				}
+				else if (fluid->pressureSolver == PressureSolver::SPECTRAL) {
+					std::cout << "Pressure Solver: fft (direct)" << std::endl;
+				}
+				else {
+					std::cout << "Pressure Solver: relax (" << fluid->divIter << " iterations)" << std::endl;
+				}
+				return true;
+			}
+
+			if (list[1] == "tolerance" || list[1] == "tol") {
+				std::cout << "Pressure Tolerance: " << fluid->pressureTolerance << std::endl;
+				return true;
+			}
+
+			if (list[1] == "maxiter") {
+				std::cout << "Pressure Max Iterations: " << fluid->pressureMaxIterations << std::endl;
+				return true;
+			}
+
+			if (list[1] == "residual") {
+				std::cout << "Pressure Residual: " << fluid->pressureResidual << " after " << fluid->pressureIterations << " iterations" << std::endl;
+				return true;
+			}
+
 			if (list[1] == "blur") {
 				std::cout << "Blur Iterations: " << blurIterations << std::endl;
+				std::cout << "Blur Mode: " << (blur->mode == DUAL_BLUR ? "dual" : "gaussian") << std::endl;
+				return true;
+			}
+
+			if (list[1] == "profile") {
+				std::cout << "----- Profile -----" << std::endl;
+				fluid->profiler.print(std::cout);
+				std::cout << "-------------------" << std::endl;
 				return true;
 			}
 		}
@@ -652,6 +1181,178 @@ bool processCommand(string command) {
 		}
 	}
 
+	if (list[0] == "capture") {
+		if (list.size() > 1) {
+			if (list[1] == "start" && list.size() > 2) {
+				FrameFormat format = FrameFormat::FLOAT_FRAMES;
+				bool includeVelocity = false;
+
+				for (int i = 3; i < list.size(); i++) {
+					if (list[i] == "raw") {
+						format = FrameFormat::FLOAT_FRAMES;
+					}
+					else if (list[i] == "rgb8") {
+						format = FrameFormat::RGB8_FRAMES;
+					}
+					else if (list[i] == "y4m") {
+						format = FrameFormat::Y4M_FRAMES;
+					}
+					else if (list[i] == "velocity") {
+						includeVelocity = true;
+					}
+					else {
+						return false;
+					}
+				}
+
+				if (!frameWriter.start(list[2], format, includeVelocity, *fluid)) {
+					std::cout << "Could not open " << list[2] << std::endl;
+					return false;
+				}
+				std::cout << "Capturing frames to " << list[2] << std::endl;
+				return true;
+			}
+
+			if (list[1] == "stop") {
+				if (!frameWriter.isCapturing()) {
+					return false;
+				}
+
+				frameWriter.stop();
+				std::cout << "Captured " << frameWriter.getWrittenFrames() << " frames (" << frameWriter.getDroppedFrames() << " dropped)" << std::endl;
+				return true;
+			}
+		}
+	}
+
+	if (list[0] == "save") {
+		if (list.size() > 1) {
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+			string error;
+			if (!saveCheckpoint(*fluid, list[1], error)) {
+				std::cout << "Could not save: " << error << std::endl;
+				return false;
+			}
+
+			double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			std::cout << "Saved to " << list[1] << " in " << milliseconds << " ms" << std::endl;
+			return true;
+		}
+	}
+
+	if (list[0] == "load") {
+		if (list.size() > 1) {
+			if (inputRecorder.isRecording() || inputReplay.isPlaying()) {
+				std::cout << "Can't load while recording or replaying" << std::endl;
+				return false;
+			}
+
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+			string error;
+			if (!loadCheckpoint(*fluid, list[1], error)) {
+				std::cout << "Could not load: " << error << std::endl;
+				return false;
+			}
+
+			// the checkpoint brings its own grid size
+			resolution = fluid->size;
+
+			double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			std::cout << "Loaded " << list[1] << " (" << resolution << "x" << resolution << ") in " << milliseconds << " ms" << std::endl;
+			return true;
+		}
+	}
+
+	if (list[0] == "record") {
+		if (list.size() > 1) {
+			if (list[1] == "start" && list.size() > 2) {
+				if (inputReplay.isPlaying()) {
+					std::cout << "Can't record while a replay is running" << std::endl;
+					return false;
+				}
+
+				if (!inputRecorder.start(list[2], *fluid)) {
+					std::cout << "Could not open " << list[2] << std::endl;
+					return false;
+				}
+				std::cout << "Recording input to " << list[2] << " (the sim was cleared so the replay starts from the same state)" << std::endl;
+				return true;
+			}
+
+			if (list[1] == "stop") {
+				if (!inputRecorder.isRecording()) {
+					return false;
+				}
+
+				std::cout << "Recorded " << inputRecorder.getFrame() << " frames" << std::endl;
+				inputRecorder.stop();
+				return true;
+			}
+		}
+	}
+
+	if (list[0] == "replay") {
+		if (list.size() > 1) {
+			if (list[1] == "stop") {
+				if (!inputReplay.isPlaying()) {
+					return false;
+				}
+
+				inputReplay.stop();
+				std::cout << "Replay stopped at frame " << inputReplay.getFrame() << std::endl;
+				return true;
+			}
+
+			if (inputRecorder.isRecording()) {
+				std::cout << "Can't replay while recording" << std::endl;
+				return false;
+			}
+
+			if (!inputReplay.load(list[1])) {
+				std::cout << "Could not read a recording from " << list[1] << std::endl;
+				return false;
+			}
+
+			// the grid takes the recording's size
+			resolution = inputReplay.header.size;
+			inputReplay.begin(*fluid);
+
+			replayStart = std::chrono::steady_clock::now();
+			std::cout << "Replaying " << inputReplay.getFrameCount() << " frames from " << list[1] << std::endl;
+			return true;
+		}
+	}
+
+	if (list[0] == "trace") {
+		if (list.size() > 1) {
+			if (list[1] == "start" && list.size() > 2) {
+				if (!traceRecorder.start(list[2])) {
+					std::cout << "Could not open " << list[2] << std::endl;
+					return false;
+				}
+				std::cout << "Tracing to " << list[2] << std::endl;
+				return true;
+			}
+
+			if (list[1] == "stop") {
+				if (!traceRecorder.isRecording()) {
+					return false;
+				}
+
+				traceRecorder.stop();
+				if (traceRecorder.getDroppedSpans() > 0) {
+					std::cout << "Trace stopped, " << traceRecorder.getDroppedSpans() << " spans were dropped" << std::endl;
+				}
+				else {
+					std::cout << "Trace stopped" << std::endl;
+				}
+				return true;
+			}
+		}
+	}
+
 	return false;
 }
 
@@ -681,9 +1382,11 @@ void processControls(GLFWwindow* window, FluidBox& fluid, ControlMode& controlMo
 		if (fPressed == false) {
 			if (fluid.getFreezeVelocity()) {
 				fluid.unfreezeVelocity();
+				inputRecorder.recordCommand("unfreeze velocity");
 			}
 			else {
 				fluid.freezeVelocity();
+				inputRecorder.recordCommand("freeze velocity");
 			}
 		}
 
@@ -696,6 +1399,7 @@ void processControls(GLFWwindow* window, FluidBox& fluid, ControlMode& controlMo
 	// clear screen controls
 	if (glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS) {
 		fluid.clear();
+		inputRecorder.recordCommand("clear");
 	}
 
 	// enter commands
@@ -757,24 +1461,46 @@ void addDirectionalFluid(FluidBox& fluid, int brushSize, float densityInc, float
 		color = glm::vec3(defaultColor);
 	}
 
-	for (int y = -brushSize; y < brushSize; y++) {
-		for (int x = -brushSize; x < brushSize; x++) {
-			// make a circle for the density and velocity to be added
-			if (glm::length(glm::vec2(x, y)) <= brushSize) {
-				glm::vec2 cpos = glm::vec2(pos.x + x, pos.y + y);
-				// skip if the pos is out of bounds
-				if (!constrain(cpos, 1, fluid.size - 2)) {
-					fluid.addDensity(cpos, densityInc * (float(std::rand()) / INT_MAX + 0.5f), color);
-					if (!fluid.getFreezeVelocity()) {
-						fluid.addVelocity(cpos, velocityInc * dir);
-					}
-				}
-			}
-		}
-	}
+	fluid.splat(pos, dir, brushSize, densityInc, velocityInc, color);
+	inputRecorder.recordSplat(pos, dir, brushSize, densityInc, velocityInc, color);
 
 	if (enableTracers) {
 		fluid.addTracer(pos, tracerColor);
+		inputRecorder.recordTracer(pos, tracerColor);
+	}
+}
+
+// feeds the sim the next recorded frame instead of the mouse and keyboard
+void replayFrame() {
+	if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS) {
+		glfwSetWindowShouldClose(window, true);
+	}
+
+	freeze = inputReplay.nextFrame(*fluid, [](string command) {
+		processCommand(command);
+	});
+
+	if (!inputReplay.isPlaying()) {
+		double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - replayStart).count();
+		std::cout << "Replay finished: " << inputReplay.getFrameCount() << " frames in " << milliseconds << " ms (" << milliseconds / max(1u, inputReplay.getFrameCount()) << " ms per frame)" << std::endl;
+	}
+}
+
+// keeps the commands that change what the sim does, thread count, simd level, step rate and transfer format only change
+// how fast it runs or how it's shown, so a replay leaves whatever the user picked for those alone
+void recordCommand(string command) {
+	std::vector<string> list = seperateStringBySpaces(command);
+
+	if (list.size() == 0 || !inputRecorder.isRecording()) {
+		return;
+	}
+
+	if (list[0] == "set" && list.size() > 1 && (list[1] == "threads" || list[1] == "simd" || list[1] == "rate" || list[1] == "transfer")) {
+		return;
+	}
+
+	if (list[0] == "set" || list[0] == "clear" || list[0] == "freeze" || list[0] == "unfreeze") {
+		inputRecorder.recordCommand(command);
 	}
 }
 
@@ -793,45 +1519,8 @@ void containTracers(FluidBox& fluid, int min, int max) {
 	}
 }
 
-void updateData(FluidBox &fluidBox, float* data) {
-	int index = 0;
-
-	for (int y = 0; y < fluidBox.size; y++) {
-		for (int x = 0; x < fluidBox.size; x++) {
-			data[index] = float(x) / fluidBox.size;
-			data[index + 1] = float(y) / fluidBox.size;
-
-			//data[index + 2] = 0;
-			//data[index + 3] = 0;
-			//data[index + 4] = 0;
-			
-			//float color = (fluidBox.density[y][x] / 255.0f);
-			//data[index + 2] = color;
-			//data[index + 3] = color;
-			//data[index + 4] = color;
-
-			// get color from the rgb density maps in the fluid sim
-			glm::vec3 color = fluidBox.getColorAtPos(glm::vec2(x,y));
-			data[index + 2] = color.x;
-			data[index + 3] = color.y;
-			data[index + 4] = color.z;
-
-			//float alpha = fluidBox.density[y][x] / 255.0f;
-			//glm::vec3 color = alpha * fluidBox.getColorAtPos(glm::vec2(x, y));
-			//data[index + 2] = color.x/255;
-			//data[index + 3] = color.y/255;
-			//data[index + 4] = color.z/255;
-
-			//data[index + 2] = fluidBox.density[y][x] / 255.0f;
-			//data[index + 3] = 1000 * abs(fluidBox.velocity->getXList()[y][x]) / 255.0f;
-			//data[index + 4] = 1000 * abs(fluidBox.velocity->getYList()[y][x]) / 255.0f;
-
-			//data[index + 2] = std::fmod(fluidBox.density[y][x] + 50, 200.0f) / 255.0f;
-			//data[index + 3] = 200 / 255.0f;
-			//data[index + 4] = fluidBox.density[y][x] / 255.0f;
-			index += 5;
-		}
-	}
+void updateData(FluidBox &fluidBox, TexelFormat format, void* data) {
+	packDensityTexels(fluidBox, format, data);
 
 	// override color if a tracer is there
 	if (enableTracers) {
@@ -846,11 +1535,11 @@ void updateData(FluidBox &fluidBox, float* data) {
 					int newX = x + ix;
 					int newY = y + iy;
 
-					if (newX >= 0 && newX < resolution && newY >= 0 && newY < resolution) {
+					if (newX >= 0 && newX < fluidBox.size && newY >= 0 && newY < fluidBox.size) {
 						float length = glm::length(glm::vec2(ix, iy));
 
 						if (length <= tracerRadius) {
-							int index = (newY * (fluidBox.size) + newX) * 5;
+							size_t cell = size_t(newY) * fluidBox.size + newX;
 
 							float power = length / 2.0f;
 
@@ -858,9 +1547,7 @@ void updateData(FluidBox &fluidBox, float* data) {
 								power = 1;
 							}
 
-							data[index + 2] = tracers[i].color.x * power;
-							data[index + 3] = tracers[i].color.y * power;
-							data[index + 4] = tracers[i].color.z * power;
+							setDensityTexel(fluidBox, format, data, cell, tracers[i].color * power);
 						}
 					}
 				}
@@ -869,22 +1556,6 @@ void updateData(FluidBox &fluidBox, float* data) {
 	}
 }
 
-void updateBuffers(RenderObject* renderObject) {
-	glBindVertexArray(renderObject->VAO);
-
-	glBindBuffer(GL_ARRAY_BUFFER, renderObject->VBO);
-	glBufferData(GL_ARRAY_BUFFER, ((resolution * resolution) * (2 + 3))*sizeof(float), renderObject->data, GL_STATIC_DRAW);
-
-	// position
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
-	// color
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(2 * sizeof(float)));
-
-	glBindVertexArray(0);
-}
-
 void incrementColorIndex() {
 	colorIndex = (colorIndex + colorInc) % colorSpectSize;
 }
@@ -900,11 +1571,11 @@ glm::vec3 getColorSpect(float n, float m) {
 	float a = 5 * PI * n / (3 * m) + PI / 2;
 
 	float r = sin(a) * 192 + 128;
-	r = max(0, min(255, r));
+	r = max(0.0f, min(255.0f, r));
 	float g = sin(a - 2 * PI / 3) * 192 + 128;
-	g = max(0, min(255, g));
+	g = max(0.0f, min(255.0f, g));
 	float b = sin(a - 4 * PI / 3) * 192 + 128;
-	b = max(0, min(255, b));
+	b = max(0.0f, min(255.0f, b));
 
 	return glm::vec3(r, g, b);
 }
@@ -948,11 +1619,10 @@ std::vector<string> seperateStringBySpaces(string str) {
 // finds the optimal dimensions for the window
 tuple<unsigned int, unsigned int> findWindowDims(float relativeScreenSize, float aspectRatio) {
 	// set window size to max while also maintaining size ratio
-	RECT rect;
-	GetClientRect(GetDesktopWindow(), &rect);
+	const GLFWvidmode* mode = glfwGetVideoMode(glfwGetPrimaryMonitor());
 
-	unsigned int SCR_WIDTH = (rect.right - rect.left) * relativeScreenSize;
-	unsigned int SCR_HEIGHT = (rect.bottom - rect.top) * relativeScreenSize;
+	unsigned int SCR_WIDTH = mode->width * relativeScreenSize;
+	unsigned int SCR_HEIGHT = mode->height * relativeScreenSize;
 
 	return tuple<unsigned int, unsigned int>{SCR_HEIGHT, SCR_HEIGHT};
 }
@@ -0,0 +1,132 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+MappedFile::MappedFile() {
+	mapped = nullptr;
+	length = 0;
+
+#ifdef _WIN32
+	file = INVALID_HANDLE_VALUE;
+	mapping = nullptr;
+#else
+	file = -1;
+#endif
+}
+
+MappedFile::~MappedFile() {
+	close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(string path) {
+	close();
+
+	file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+		close();
+		return false;
+	}
+	length = size_t(fileSize.QuadPart);
+
+	mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mapping == nullptr) {
+		close();
+		return false;
+	}
+
+	mapped = (const unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (mapped == nullptr) {
+		close();
+		return false;
+	}
+
+	return true;
+}
+
+void MappedFile::close() {
+	if (mapped != nullptr) {
+		UnmapViewOfFile(mapped);
+	}
+	if (mapping != nullptr) {
+		CloseHandle(mapping);
+	}
+	if (file != INVALID_HANDLE_VALUE) {
+		CloseHandle(file);
+	}
+
+	mapped = nullptr;
+	mapping = nullptr;
+	file = INVALID_HANDLE_VALUE;
+	length = 0;
+}
+
+#else
+
+bool MappedFile::open(string path) {
+	close();
+
+	file = ::open(path.c_str(), O_RDONLY);
+	if (file < 0) {
+		return false;
+	}
+
+	struct stat info;
+	if (fstat(file, &info) != 0 || info.st_size == 0) {
+		close();
+		return false;
+	}
+	length = size_t(info.st_size);
+
+	void* address = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, file, 0);
+	if (address == MAP_FAILED) {
+		close();
+		return false;
+	}
+	mapped = (const unsigned char*)address;
+
+	// every byte gets copied out front to back
+	madvise(address, length, MADV_SEQUENTIAL);
+
+	return true;
+}
+
+void MappedFile::close() {
+	if (mapped != nullptr) {
+		munmap((void*)mapped, length);
+	}
+	if (file >= 0) {
+		::close(file);
+	}
+
+	mapped = nullptr;
+	file = -1;
+	length = 0;
+}
+
+#endif
+
+const unsigned char* MappedFile::data() {
+	return mapped;
+}
+
+size_t MappedFile::size() {
+	return length;
+}
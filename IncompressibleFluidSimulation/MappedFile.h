@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// A whole file mapped read only into memory, the os pages it in as it is touched.
+class MappedFile {
+public:
+	MappedFile();
+	~MappedFile();
+
+	// returns false if the file can't be opened or mapped (an empty file can't be mapped either)
+	bool open(std::string path);
+	void close();
+
+	const unsigned char* data();
+	std::size_t size();
+
+private:
+	const unsigned char* mapped;
+	std::size_t length;
+
+#ifdef _WIN32
+	void* file;
+	void* mapping;
+#else
+	int file;
+#endif
+
+	MappedFile(const MappedFile&);
+	MappedFile &operator=(const MappedFile&);
+};
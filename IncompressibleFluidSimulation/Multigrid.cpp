@@ -0,0 +1,291 @@
+#include "Multigrid.h"
+
+// index into MultigridLevel::stencil for a neighbour offset
+static int stencilIndex(int dx, int dy) {
+	return (dy + 1) * 3 + (dx + 1);
+}
+
+Multigrid::Multigrid() {
+	preSmooth = 2;
+	postSmooth = 2;
+	coarseSmooth = 20;
+}
+
+// sets up the grid hierarchy, each level keeps every other cell of the level above it
+void Multigrid::build(int size, ThreadPool* pool) {
+	levels.clear();
+
+	int n = size - 2;
+
+	while (true) {
+		MultigridLevel level;
+		level.n = n;
+		level.uStorage = Field2D(n + 2, n + 2);
+		level.fStorage = Field2D(n + 2, n + 2);
+		level.residual = Field2D(n + 2, n + 2);
+		level.u = nullptr;
+		level.f = nullptr;
+
+		levels.push_back(level);
+
+		// stop once the grid is small enough for plain relaxation to solve it outright
+		if (n <= 3) {
+			break;
+		}
+
+		n /= 2;
+	}
+
+	for (int i = 1; i < levels.size(); i++) {
+		levels[i].u = &levels[i].uStorage;
+		levels[i].f = &levels[i].fStorage;
+
+		buildGalerkinOperator(i, pool);
+	}
+}
+
+// Works out R * A * P for one coarse level by probing.
+// The coarse operator only ever couples a cell to its 3x3 neighbourhood, so pushing a pattern of ones spaced 3 cells
+// apart through P, A and R leaves exactly one neighbour's coefficient in every coarse cell. 9 patterns cover them all.
+void Multigrid::buildGalerkinOperator(int level, ThreadPool* pool) {
+	MultigridLevel &fine = levels[level - 1];
+	MultigridLevel &coarse = levels[level];
+
+	int nc = coarse.n;
+	int nf = fine.n;
+
+	coarse.stencil = std::vector<Field2D>(9, Field2D(nc + 2, nc + 2));
+
+	Field2D probe(nc + 2, nc + 2);
+	Field2D result(nc + 2, nc + 2);
+	Field2D fineIn(nf + 2, nf + 2);
+	Field2D fineOut(nf + 2, nf + 2);
+
+	for (int cy = 0; cy < 3; cy++) {
+		for (int cx = 0; cx < 3; cx++) {
+			probe.fill(0);
+			for (int y = 1; y <= nc; y++) {
+				for (int x = 1; x <= nc; x++) {
+					if (x % 3 == cx && y % 3 == cy) {
+						probe[y][x] = 1;
+					}
+				}
+			}
+
+			prolong(probe, fineIn, fine, false, pool);
+			applyOperator(fine, fineIn, fineOut, nullptr, pool);
+			restrictResidual(fineOut, result, coarse, pool);
+
+			for (int y = 1; y <= nc; y++) {
+				// which neighbour of this cell the probe pattern landed on
+				int dy = (cy - y % 3 + 3) % 3;
+				if (dy == 2) dy = -1;
+
+				for (int x = 1; x <= nc; x++) {
+					int dx = (cx - x % 3 + 3) % 3;
+					if (dx == 2) dx = -1;
+
+					coarse.stencil[stencilIndex(dx, dy)][y][x] = result[y][x];
+				}
+			}
+		}
+	}
+}
+
+void Multigrid::solve(Field2D &p, Field2D &div, int cycles, MultigridCycle cycleType, ThreadPool* pool) {
+	if (levels.empty() || levels[0].n != p.width - 2) {
+		build(p.width, pool);
+	}
+
+	levels[0].u = &p;
+	levels[0].f = &div;
+
+	for (int i = 0; i < cycles; i++) {
+		cycle(0, cycleType, pool);
+	}
+}
+
+void Multigrid::cycle(int level, MultigridCycle cycleType, ThreadPool* pool) {
+	MultigridLevel &current = levels[level];
+
+	if (level == levels.size() - 1) {
+		smooth(current, coarseSmooth, pool);
+		return;
+	}
+
+	MultigridLevel &coarse = levels[level + 1];
+
+	smooth(current, preSmooth, pool);
+	computeResidual(current, pool);
+	restrictResidual(current.residual, *coarse.f, coarse, pool);
+
+	// the coarse grid solves for the error so it always starts from zero
+	coarse.u->fill(0);
+	cycle(level + 1, cycleType, pool);
+	if (cycleType == MultigridCycle::F_CYCLE) {
+		cycle(level + 1, MultigridCycle::V_CYCLE, pool);
+	}
+
+	prolong(*coarse.u, *current.u, current, true, pool);
+	smooth(current, postSmooth, pool);
+}
+
+// out = A * in, or rhs - A * in when rhs is given
+void Multigrid::applyOperator(MultigridLevel &level, Field2D &in, Field2D &out, Field2D* rhs, ThreadPool* pool) {
+	int n = level.n;
+
+	pool->parallelFor(1, n + 1, [&](int yStart, int yEnd) {
+		for (int y = yStart; y < yEnd; y++) {
+			const float* up = in[y - 1];
+			const float* row = in[y];
+			const float* down = in[y + 1];
+			float* outRow = out[y];
+
+			if (level.stencil.empty()) {
+				for (int x = 1; x <= n; x++) {
+					outRow[x] = 4.0f * row[x] - up[x] - down[x] - row[x - 1] - row[x + 1];
+				}
+			}
+			else {
+				const std::vector<Field2D> &s = level.stencil;
+				const float* s0 = s[0][y];
+				const float* s1 = s[1][y];
+				const float* s2 = s[2][y];
+				const float* s3 = s[3][y];
+				const float* s4 = s[4][y];
+				const float* s5 = s[5][y];
+				const float* s6 = s[6][y];
+				const float* s7 = s[7][y];
+				const float* s8 = s[8][y];
+
+				for (int x = 1; x <= n; x++) {
+					outRow[x] =
+						s0[x] * up[x - 1] + s1[x] * up[x] + s2[x] * up[x + 1] +
+						s3[x] * row[x - 1] + s4[x] * row[x] + s5[x] * row[x + 1] +
+						s6[x] * down[x - 1] + s7[x] * down[x] + s8[x] * down[x + 1];
+				}
+			}
+
+			if (rhs != nullptr) {
+				const float* rhsRow = (*rhs)[y];
+
+				for (int x = 1; x <= n; x++) {
+					outRow[x] = rhsRow[x] - outRow[x];
+				}
+			}
+		}
+	});
+}
+
+// gauss seidel ordered so that no two cells updated at the same time touch each other
+// red-black is enough for the 5 point stencil, the 3x3 coarse operators need 4 colours
+void Multigrid::smooth(MultigridLevel &level, int iterations, ThreadPool* pool) {
+	Field2D &u = *level.u;
+	Field2D &f = *level.f;
+	int n = level.n;
+
+	for (int i = 0; i < iterations; i++) {
+		if (level.stencil.empty()) {
+			for (int color = 0; color < 2; color++) {
+				pool->parallelFor(1, n + 1, [&](int yStart, int yEnd) {
+					for (int y = yStart; y < yEnd; y++) {
+						float* row = u[y];
+						const float* up = u[y - 1];
+						const float* down = u[y + 1];
+						const float* fRow = f[y];
+
+						for (int x = 1 + ((y + 1 + color) & 1); x <= n; x += 2) {
+							row[x] = (fRow[x] + up[x] + down[x] + row[x - 1] + row[x + 1]) * 0.25f;
+						}
+					}
+				});
+			}
+		}
+		else {
+			const std::vector<Field2D> &s = level.stencil;
+
+			for (int color = 0; color < 4; color++) {
+				int xParity = color & 1;
+				int yParity = color >> 1;
+
+				pool->parallelFor(1, n + 1, [&](int yStart, int yEnd) {
+					for (int y = yStart; y < yEnd; y++) {
+						if ((y & 1) != yParity) {
+							continue;
+						}
+
+						float* row = u[y];
+						const float* up = u[y - 1];
+						const float* down = u[y + 1];
+						const float* fRow = f[y];
+
+						for (int x = xParity ? 1 : 2; x <= n; x += 2) {
+							float center = s[4][y][x];
+							if (center == 0) {
+								continue;
+							}
+
+							float offDiagonal =
+								s[0][y][x] * up[x - 1] + s[1][y][x] * up[x] + s[2][y][x] * up[x + 1] +
+								s[3][y][x] * row[x - 1] + s[5][y][x] * row[x + 1] +
+								s[6][y][x] * down[x - 1] + s[7][y][x] * down[x] + s[8][y][x] * down[x + 1];
+
+							row[x] = (fRow[x] - offDiagonal) / center;
+						}
+					}
+				});
+			}
+		}
+	}
+}
+
+void Multigrid::computeResidual(MultigridLevel &level, ThreadPool* pool) {
+	applyOperator(level, *level.u, level.residual, level.f, pool);
+}
+
+// full weighting of a fine grid onto the coarse grid (the transpose of prolong, scaled by 1/4)
+void Multigrid::restrictResidual(Field2D &r, Field2D &f, MultigridLevel &coarse, ThreadPool* pool) {
+	int n = coarse.n;
+
+	pool->parallelFor(1, n + 1, [&](int yStart, int yEnd) {
+		for (int y = yStart; y < yEnd; y++) {
+			const float* up = r[2 * y - 1];
+			const float* row = r[2 * y];
+			const float* down = r[2 * y + 1];
+			float* fRow = f[y];
+
+			for (int x = 1; x <= n; x++) {
+				int i = 2 * x;
+
+				fRow[x] = (
+					4.0f * row[i] +
+					2.0f * (row[i - 1] + row[i + 1] + up[i] + down[i]) +
+					up[i - 1] + up[i + 1] + down[i - 1] + down[i + 1]
+					) * (1.0f / 16.0f);
+			}
+		}
+	});
+}
+
+// bilinear interpolation of a coarse grid onto the fine grid, either added on top of it or replacing it
+// even fine cells sit on a coarse cell and odd ones halfway between two so (i / 2, (i + 1) / 2) covers both cases
+// (anything that falls on the coarse boundary ring reads zero)
+void Multigrid::prolong(Field2D &e, Field2D &u, MultigridLevel &fine, bool add, ThreadPool* pool) {
+	int n = fine.n;
+
+	pool->parallelFor(1, n + 1, [&](int yStart, int yEnd) {
+		for (int y = yStart; y < yEnd; y++) {
+			float* row = u[y];
+			const float* e0 = e[y / 2];
+			const float* e1 = e[(y + 1) / 2];
+
+			for (int x = 1; x <= n; x++) {
+				int x0 = x / 2;
+				int x1 = (x + 1) / 2;
+
+				float value = 0.25f * (e0[x0] + e0[x1] + e1[x0] + e1[x1]);
+				row[x] = add ? row[x] + value : value;
+			}
+		}
+	});
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <vector>
+
+#include "Field2D.h"
+#include "ThreadPool.h"
+
+// V walks straight down to the coarsest grid and back up once
+// F revisits every coarse level with an extra V cycle on the way up which is more robust for the same cost order
+enum MultigridCycle { V_CYCLE = 0, F_CYCLE = 1 };
+
+struct MultigridLevel {
+	// number of interior cells along one side (the grids store one boundary cell on each side as well)
+	int n;
+
+	// level 0 points at the caller's pressure and divergence, coarser levels point at their own storage
+	Field2D* u;
+	Field2D* f;
+
+	Field2D uStorage;
+	Field2D fStorage;
+	Field2D residual;
+
+	// 3x3 operator of a coarse level, one coefficient grid per neighbour offset (index (dy + 1) * 3 + dx + 1)
+	// level 0 has none since it is always the 5 point stencil used by project
+	std::vector<Field2D> stencil;
+};
+
+// Geometric multigrid for the pressure poisson problem that project builds:
+// 4p - (sum of the 4 neighbours) = div on the interior, with the outer ring of p kept as a fixed boundary
+// (removeDivergence with b = 0 never writes the ring either so both solvers see the same problem)
+//
+// Coarse cell I sits on fine cell 2I. Grid sizes are arbitrary so the coarse boundaries do not always line up with the
+// fine ones, which is why the coarse operators are built as R * A * P (galerkin) instead of rediscretizing the stencil.
+class Multigrid {
+public:
+	int preSmooth;
+	int postSmooth;
+	int coarseSmooth;
+
+	Multigrid();
+
+	void solve(Field2D &p, Field2D &div, int cycles, MultigridCycle cycleType, ThreadPool* pool);
+
+private:
+	std::vector<MultigridLevel> levels;
+
+	void build(int size, ThreadPool* pool);
+	void buildGalerkinOperator(int level, ThreadPool* pool);
+	void cycle(int level, MultigridCycle cycleType, ThreadPool* pool);
+
+	void applyOperator(MultigridLevel &level, Field2D &in, Field2D &out, Field2D* rhs, ThreadPool* pool);
+	void smooth(MultigridLevel &level, int iterations, ThreadPool* pool);
+	void computeResidual(MultigridLevel &level, ThreadPool* pool);
+	void restrictResidual(Field2D &r, Field2D &f, MultigridLevel &coarse, ThreadPool* pool);
+	void prolong(Field2D &e, Field2D &u, MultigridLevel &fine, bool add, ThreadPool* pool);
+};
@@ -0,0 +1,78 @@
+#include "Profiler.h"
+
+#include <algorithm>
+#include <iomanip>
+
+using namespace std;
+
+int Profiler::addPhase(string name) {
+	Phase phase;
+	phase.name = name;
+	phase.samples = vector<float>(SAMPLE_COUNT, 0.0f);
+	phase.next = 0;
+	phase.count = 0;
+
+	phases.push_back(phase);
+	return int(phases.size()) - 1;
+}
+
+void Profiler::record(int phase, double milliseconds) {
+	Phase &target = phases[phase];
+
+	target.samples[target.next] = float(milliseconds);
+	target.next = (target.next + 1) % SAMPLE_COUNT;
+	target.count = min(target.count + 1, SAMPLE_COUNT);
+}
+
+const string &Profiler::getPhaseName(int phase) {
+	return phases[phase].name;
+}
+
+void Profiler::reset() {
+	for (int i = 0; i < phases.size(); i++) {
+		phases[i].next = 0;
+		phases[i].count = 0;
+	}
+}
+
+void Profiler::print(ostream &out) {
+	size_t nameWidth = 5;
+	for (int i = 0; i < phases.size(); i++) {
+		nameWidth = max(nameWidth, phases[i].name.size());
+	}
+
+	ios::fmtflags flags = out.flags();
+	streamsize precision = out.precision();
+
+	out << fixed << setprecision(3);
+	out << left << setw(nameWidth) << "phase" << right << setw(10) << "mean" << setw(10) << "p50" << setw(10) << "p99" << setw(10) << "max" << "   (ms)" << endl;
+
+	for (int i = 0; i < phases.size(); i++) {
+		Phase &phase = phases[i];
+
+		out << left << setw(nameWidth) << phase.name << right;
+
+		if (phase.count == 0) {
+			out << setw(10) << "-" << endl;
+			continue;
+		}
+
+		// the ring only holds the valid samples at the front until it has wrapped once
+		vector<float> sorted(phase.samples.begin(), phase.samples.begin() + phase.count);
+		sort(sorted.begin(), sorted.end());
+
+		double sum = 0;
+		for (int s = 0; s < sorted.size(); s++) {
+			sum += sorted[s];
+		}
+
+		int count = int(sorted.size());
+		float p50 = sorted[(count - 1) / 2];
+		float p99 = sorted[min(count - 1, int(count * 0.99))];
+
+		out << setw(10) << sum / count << setw(10) << p50 << setw(10) << p99 << setw(10) << sorted.back() << "   (" << count << " samples)" << endl;
+	}
+
+	out.flags(flags);
+	out.precision(precision);
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "TraceRecorder.h"
+
+// Keeps the last SAMPLE_COUNT durations of each named phase so a slow frame can be traced to the phase that caused it
+// while the sim is running. Recording a sample is two clock reads and a store into a fixed ring,
+// the statistics are only worked out when they are printed.
+class Profiler {
+public:
+	static const int SAMPLE_COUNT = 256;
+
+	// registers a phase and returns the id to record it under, phases print in the order they were added
+	int addPhase(std::string name);
+
+	void record(int phase, double milliseconds);
+
+	const std::string &getPhaseName(int phase);
+
+	// forgets every sample but keeps the phases
+	void reset();
+
+	// mean, p50, p99 and max of each phase over its last SAMPLE_COUNT samples
+	void print(std::ostream &out);
+
+private:
+	struct Phase {
+		std::string name;
+		std::vector<float> samples;
+		int next;
+		int count;
+	};
+
+	std::vector<Phase> phases;
+};
+
+// times the scope it lives in and records it as one sample of a phase (and as a span if a trace is being captured)
+class ScopedTimer {
+public:
+	ScopedTimer(Profiler &profiler, int phase) : profiler(profiler), phase(phase) {
+		start = std::chrono::steady_clock::now();
+	}
+
+	~ScopedTimer() {
+		std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+		profiler.record(phase, std::chrono::duration<double, std::milli>(end - start).count());
+
+		if (traceRecorder.isRecording()) {
+			traceRecorder.addSpan(profiler.getPhaseName(phase).c_str(), start, end);
+		}
+	}
+
+private:
+	Profiler &profiler;
+	int phase;
+	std::chrono::steady_clock::time_point start;
+};
@@ -1,19 +1,199 @@
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 
+#include <utility>
+
 #include "RenderObject.h"
 
+using namespace std;
+
+static GLenum texelType(TexelFormat format) {
+	switch (format) {
+	case HALF_TEXELS:
+		return GL_HALF_FLOAT;
+	case SRGB8_TEXELS:
+		return GL_UNSIGNED_BYTE;
+	default:
+		return GL_FLOAT;
+	}
+}
+
+static void setupDensityTexture(unsigned int texture, int size, TexelFormat format) {
+	glBindTexture(GL_TEXTURE_2D, texture);
+
+	// the srgb texture is decoded back to linear when it's sampled, nearest keeps each cell a hard edged square
+	GLenum internalFormat = format == HALF_TEXELS ? GL_RGB16F : (format == SRGB8_TEXELS ? GL_SRGB8 : GL_RGB32F);
+	glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, size, size, 0, GL_RGB, texelType(format), NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+}
+
+GLenum renderTargetFormat(TexelFormat format) {
+	switch (format) {
+	case HALF_TEXELS:
+		return GL_RGBA16F;
+	case SRGB8_TEXELS:
+		return GL_SRGB8_ALPHA8;
+	default:
+		return GL_RGB;
+	}
+}
+
 RenderObject::RenderObject() {
-	data = nullptr;
+	size = 0;
+	format = FLOAT_TEXELS;
+
+	glGenTextures(1, &texture);
+	glGenTextures(1, &previousTexture);
+
+	persistent = GLAD_GL_VERSION_4_4 && glBufferStorage != NULL;
+
+	glGenBuffers(BUFFER_COUNT, buffers);
+	for (int i = 0; i < BUFFER_COUNT; i++) {
+		fences[i] = NULL;
+		mapped[i] = nullptr;
+		capacity[i] = 0;
+	}
+
+	writeBuffer = BUFFER_COUNT - 1;
+	writeSize = 0;
+	writeFormat = FLOAT_TEXELS;
+	writePrevious = false;
+}
+
+RenderObject::~RenderObject() {
+	for (int i = 0; i < BUFFER_COUNT; i++) {
+		waitForBuffer(i);
+
+		if (mapped[i] != nullptr) {
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffers[i]);
+			glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		}
+	}
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	glDeleteBuffers(BUFFER_COUNT, buffers);
+	glDeleteTextures(1, &texture);
+	glDeleteTextures(1, &previousTexture);
+}
+
+void* RenderObject::beginWrite(int size, TexelFormat format, bool &withPrevious) {
+	// the last state drawn at another size or in another format can't be blended from
+	if (size != writeSize || format != writeFormat) {
+		withPrevious = true;
+	}
+
+	writeBuffer = (writeBuffer + 1) % BUFFER_COUNT;
+	writeSize = size;
+	writeFormat = format;
+	writePrevious = withPrevious;
+
+	// always room for the previous step so the buffers only grow with the grid
+	size_t bytes = 2 * size_t(size) * size * DENSITY_TEXEL_FLOATS * texelChannelBytes(format);
+
+	if (persistent) {
+		waitForBuffer(writeBuffer);
+
+		if (capacity[writeBuffer] < bytes) {
+			allocateBuffer(writeBuffer, bytes);
+		}
+	}
+	else {
+		// new storage each time, the driver keeps the old one alive until the gpu is done with it
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffers[writeBuffer]);
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, NULL, GL_STREAM_DRAW);
+		mapped[writeBuffer] = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+		capacity[writeBuffer] = bytes;
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	}
 
-	glGenBuffers(1, &VBO);
-	glGenVertexArrays(1, &VAO);
+	return mapped[writeBuffer];
 }
 
-void RenderObject::allocateMemory(int size) {
-	if (data != nullptr) {
-		delete[] data;
+void RenderObject::upload() {
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffers[writeBuffer]);
+
+	if (!persistent) {
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		mapped[writeBuffer] = nullptr;
+	}
+
+	// a texture can't be reallocated from the pixel buffer
+	if (writeSize != size || writeFormat != format) {
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		resize(writeSize, writeFormat);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffers[writeBuffer]);
+	}
+
+	if (!writePrevious) {
+		swap(texture, previousTexture);
+	}
+
+	// with an unpack buffer bound the data pointer is an offset into it
+	// rows of 8 or 16 bit channels aren't always 4 byte aligned so the rows are read tightly packed
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, size, size, GL_RGB, texelType(format), (void*)0);
+
+	if (writePrevious) {
+		glBindTexture(GL_TEXTURE_2D, previousTexture);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, size, size, GL_RGB, texelType(format), (void*)(size_t(size) * size * DENSITY_TEXEL_FLOATS * texelChannelBytes(format)));
+	}
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	// a persistent buffer is free again once the copies above have run, an orphaned one never needs waiting for
+	if (persistent) {
+		fences[writeBuffer] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+}
+
+bool RenderObject::isPersistent() {
+	return persistent;
+}
+
+void RenderObject::resize(int size, TexelFormat format) {
+	if (size == this->size && format == this->format) {
+		return;
+	}
+
+	this->size = size;
+	this->format = format;
+
+	setupDensityTexture(texture, size, format);
+	setupDensityTexture(previousTexture, size, format);
+}
+
+void RenderObject::waitForBuffer(int buffer) {
+	if (fences[buffer] == NULL) {
+		return;
 	}
 
-	data = new float[size];
-}
\ No newline at end of file
+	while (glClientWaitSync(fences[buffer], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED) {}
+
+	glDeleteSync(fences[buffer]);
+	fences[buffer] = NULL;
+}
+
+void RenderObject::allocateBuffer(int buffer, size_t bytes) {
+	// buffer storage is immutable so a bigger one needs a new buffer
+	if (mapped[buffer] != nullptr) {
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffers[buffer]);
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		glDeleteBuffers(1, &buffers[buffer]);
+		glGenBuffers(1, &buffers[buffer]);
+	}
+
+	GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffers[buffer]);
+	glBufferStorage(GL_PIXEL_UNPACK_BUFFER, bytes, NULL, flags);
+	mapped[buffer] = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes, flags);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	capacity[buffer] = bytes;
+}
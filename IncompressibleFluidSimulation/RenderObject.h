@@ -1,18 +1,66 @@
 #pragma once
 
+#include <cstddef>
+
 #include <shader.h>
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 
+#include "DensityPacking.h"
+
+// The fluid's rgb density as a texture with one texel per cell, drawn by stretching it over a full screen quad.
+// The state one step earlier is kept in a second texture so the shader can blend between the two.
+//
+// The density is packed straight into one of BUFFER_COUNT pixel buffers and the textures are filled from there on the
+// gpu, so there's no copy of our own and the driver doesn't copy out of our memory while the frame waits. Where the
+// context has buffer storage (GL 4.4) the buffers are mapped once for good and a fence per buffer says when the gpu has
+// finished reading it. Otherwise each write maps its buffer fresh, orphaning the old storage so the map never waits.
+// Three buffers cover one being packed, one being uploaded and one the gpu may still be reading.
 class RenderObject {
 public:
+	static const int BUFFER_COUNT = 3;
+
 	Shader shader;
-	unsigned int VAO;
-	unsigned int VBO;
+	unsigned int texture;
+	unsigned int previousTexture;
 
-	float* data;
+	// cells along each side of the textures and what they hold
+	int size;
+	TexelFormat format;
 
 	RenderObject();
+	~RenderObject();
+
+	// GL thread only. Returns room for size * size cells packed in format (row by row from the bottom) followed by as many
+	// again for the previous step if withPrevious is set, which it is on return if a new size or format needs the previous
+	// step as well. Any thread may fill it until upload.
+	void* beginWrite(int size, TexelFormat format, bool &withPrevious);
+
+	// GL thread only, once the write is filled. Without a previous step the texture that was current becomes the previous one.
+	void upload();
+
+	bool isPersistent();
+
+private:
+	unsigned int buffers[BUFFER_COUNT];
+	GLsync fences[BUFFER_COUNT];
+	void* mapped[BUFFER_COUNT];
+	std::size_t capacity[BUFFER_COUNT];
+
+	bool persistent;
+
+	// the buffer handed out by the last beginWrite and what's in it
+	int writeBuffer;
+	int writeSize;
+	TexelFormat writeFormat;
+	bool writePrevious;
+
+	// reallocates both textures if the grid size or format changed
+	void resize(int size, TexelFormat format);
+
+	void waitForBuffer(int buffer);
+	void allocateBuffer(int buffer, std::size_t bytes);
+};
 
-	void allocateMemory(int size);
-};
\ No newline at end of file
+// internal format for the render targets the density is drawn into and blurred through, kept at least as fine as format
+GLenum renderTargetFormat(TexelFormat format);
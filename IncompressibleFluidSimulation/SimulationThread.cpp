@@ -0,0 +1,64 @@
+#include "SimulationThread.h"
+
+#include "TraceRecorder.h"
+
+using namespace std;
+
+SimulationThread::SimulationThread() {
+	busy = false;
+	stopping = false;
+
+	worker = thread(&SimulationThread::workerLoop, this);
+}
+
+SimulationThread::~SimulationThread() {
+	{
+		lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wake.notify_one();
+
+	worker.join();
+}
+
+void SimulationThread::post(function<void()> job) {
+	{
+		lock_guard<std::mutex> lock(mutex);
+		this->job = job;
+		busy = true;
+	}
+	wake.notify_one();
+}
+
+void SimulationThread::wait() {
+	unique_lock<std::mutex> lock(mutex);
+	done.wait(lock, [this] { return !busy; });
+}
+
+void SimulationThread::workerLoop() {
+	traceRecorder.setThreadName("simulation");
+
+	while (true) {
+		function<void()> current;
+		{
+			unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [this] { return busy || stopping; });
+
+			// a posted job still runs before the thread stops
+			if (!busy) {
+				return;
+			}
+
+			current = job;
+		}
+
+		current();
+
+		{
+			lock_guard<std::mutex> lock(mutex);
+			job = nullptr;
+			busy = false;
+		}
+		done.notify_all();
+	}
+}
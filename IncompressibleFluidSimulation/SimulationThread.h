@@ -0,0 +1,34 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+// One long lived thread that runs a single job at a time for its owner, used to step the sim alongside the renderer.
+// post hands it the next job and returns straight away, wait blocks until that job has finished.
+// Between wait and the next post the owner has the sim to itself.
+class SimulationThread {
+public:
+	SimulationThread();
+	~SimulationThread();
+
+	// the previous job has to have been waited for
+	void post(std::function<void()> job);
+
+	// returns straight away if nothing is running
+	void wait();
+
+private:
+	std::thread worker;
+
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+
+	std::function<void()> job;
+	bool busy;
+	bool stopping;
+
+	void workerLoop();
+};
@@ -0,0 +1,163 @@
+#include "SpectralSolver.h"
+
+#include <cmath>
+
+static const double PI = 3.14159265358979323846;
+
+SpectralSolver::SpectralSolver() {
+	n = 0;
+}
+
+void SpectralSolver::build(int size) {
+	n = size - 2;
+
+	fft = FFT(2 * (n + 1));
+
+	eigenvalues = std::vector<double>(n + 2, 0);
+	for (int k = 1; k <= n; k++) {
+		eigenvalues[k] = 2.0 - 2.0 * std::cos(PI * k / (n + 1));
+	}
+
+	coefficients = Field2D(size, size);
+}
+
+void SpectralSolver::solve(Field2D &p, Field2D &div, ThreadPool* pool) {
+	if (n != p.width - 2) {
+		build(p.width);
+	}
+
+	// the sine modes are all zero on the ring, so any ring values get moved over to the right hand side
+	pool->parallelFor(1, n + 1, [&](int yStart, int yEnd) {
+		for (int y = yStart; y < yEnd; y++) {
+			const float* divRow = div[y];
+			float* row = coefficients[y];
+
+			for (int x = 1; x <= n; x++) {
+				row[x] = divRow[x];
+			}
+
+			row[1] += p[y][0];
+			row[n] += p[y][n + 1];
+
+			if (y == 1) {
+				for (int x = 1; x <= n; x++) {
+					row[x] += p[0][x];
+				}
+			}
+			if (y == n) {
+				for (int x = 1; x <= n; x++) {
+					row[x] += p[n + 1][x];
+				}
+			}
+		}
+	});
+
+	sineTransformRows(coefficients, pool);
+	sineTransformColumns(coefficients, pool);
+
+	pool->parallelFor(1, n + 1, [&](int yStart, int yEnd) {
+		for (int y = yStart; y < yEnd; y++) {
+			float* row = coefficients[y];
+
+			for (int x = 1; x <= n; x++) {
+				row[x] = float(row[x] / (eigenvalues[x] + eigenvalues[y]));
+			}
+		}
+	});
+
+	// DST-I is its own inverse up to a factor of 2 / (n + 1) per axis
+	sineTransformRows(coefficients, pool);
+	sineTransformColumns(coefficients, pool);
+
+	float scale = float(4.0 / (double(n + 1) * (n + 1)));
+
+	pool->parallelFor(1, n + 1, [&](int yStart, int yEnd) {
+		for (int y = yStart; y < yEnd; y++) {
+			const float* row = coefficients[y];
+			float* pRow = p[y];
+
+			for (int x = 1; x <= n; x++) {
+				pRow[x] = row[x] * scale;
+			}
+		}
+	});
+}
+
+// two rows go through each complex transform, one as the real part and one as the imaginary part
+void SpectralSolver::sineTransformRows(Field2D &grid, ThreadPool* pool) {
+	int pairs = (n + 1) / 2;
+
+	pool->parallelFor(0, pairs, [&](int start, int end) {
+		std::vector<std::complex<double>> buffer(fft.length);
+		std::vector<std::complex<double>> scratch(fft.scratchSize());
+
+		for (int pair = start; pair < end; pair++) {
+			int y0 = 1 + 2 * pair;
+			int y1 = y0 + 1;
+
+			float* row0 = grid[y0];
+			float* row1 = (y1 <= n) ? grid[y1] : nullptr;
+
+			for (int x = 1; x <= n; x++) {
+				buffer[x] = std::complex<double>(row0[x], row1 ? row1[x] : 0.0f);
+			}
+
+			sineTransformPair(buffer, scratch);
+
+			for (int x = 1; x <= n; x++) {
+				row0[x] = float(buffer[x].real());
+				if (row1) {
+					row1[x] = float(buffer[x].imag());
+				}
+			}
+		}
+	});
+}
+
+void SpectralSolver::sineTransformColumns(Field2D &grid, ThreadPool* pool) {
+	int pairs = (n + 1) / 2;
+
+	pool->parallelFor(0, pairs, [&](int start, int end) {
+		std::vector<std::complex<double>> buffer(fft.length);
+		std::vector<std::complex<double>> scratch(fft.scratchSize());
+
+		for (int pair = start; pair < end; pair++) {
+			int x0 = 1 + 2 * pair;
+			int x1 = x0 + 1;
+			bool hasSecond = x1 <= n;
+
+			for (int y = 1; y <= n; y++) {
+				buffer[y] = std::complex<double>(grid[y][x0], hasSecond ? grid[y][x1] : 0.0f);
+			}
+
+			sineTransformPair(buffer, scratch);
+
+			for (int y = 1; y <= n; y++) {
+				grid[y][x0] = float(buffer[y].real());
+				if (hasSecond) {
+					grid[y][x1] = float(buffer[y].imag());
+				}
+			}
+		}
+	});
+}
+
+// buffer[1..n] holds a + ib for two real sequences and gets replaced by DST(a) + i DST(b)
+// the odd extension of a real sequence transforms to -2i DST, so the two results come apart without any extra work
+void SpectralSolver::sineTransformPair(std::vector<std::complex<double>> &buffer, std::vector<std::complex<double>> &scratch) {
+	int length = fft.length;
+
+	buffer[0] = 0;
+	buffer[n + 1] = 0;
+	for (int j = 1; j <= n; j++) {
+		buffer[length - j] = -buffer[j];
+	}
+
+	fft.forward(buffer.data(), scratch.data());
+
+	for (int k = 1; k <= n; k++) {
+		double a = -0.5 * buffer[k].imag();
+		double b = 0.5 * buffer[k].real();
+		buffer[k] = std::complex<double>(a, b);
+	}
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <vector>
+
+#include "FFT.h"
+#include "Field2D.h"
+#include "ThreadPool.h"
+
+// Direct solve of the pressure problem the other backends iterate on:
+// 4p - (sum of the 4 neighbours) = div on the interior with the outer ring of p as a fixed boundary.
+// The ring is a dirichlet boundary so the sine transform (DST-I) diagonalizes the stencil exactly, each mode is divided
+// by its eigenvalue and transformed back. One pass gives the exact solution (up to rounding) for a fixed O(n^2 log n) cost.
+class SpectralSolver {
+public:
+	SpectralSolver();
+
+	void solve(Field2D &p, Field2D &div, ThreadPool* pool);
+
+private:
+	int n;
+
+	// each DST-I of length n is the imaginary part of a transform of its odd extension which has length 2(n + 1)
+	FFT fft;
+
+	// eigenvalue of the 1d stencil (2 - left - right) for each sine mode
+	std::vector<double> eigenvalues;
+
+	Field2D coefficients;
+
+	void build(int size);
+
+	void sineTransformRows(Field2D &grid, ThreadPool* pool);
+	void sineTransformColumns(Field2D &grid, ThreadPool* pool);
+	void sineTransformPair(std::vector<std::complex<double>> &buffer, std::vector<std::complex<double>> &scratch);
+};
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// Fixed size queue between exactly one producer thread and one consumer thread, push and pop never lock or allocate.
+// Each side only writes its own index so the two indices live on separate cache lines to keep them from bouncing
+// between the two cores, and each side keeps a cached copy of the other's index so most calls don't touch it at all.
+template <typename T>
+class SpscQueue {
+public:
+	// capacity is rounded up to a power of two
+	SpscQueue(std::size_t capacity) {
+		std::size_t size = 2;
+		while (size < capacity) {
+			size *= 2;
+		}
+
+		slots = std::vector<T>(size);
+		mask = size - 1;
+
+		head.store(0);
+		tail.store(0);
+		cachedHead = 0;
+		cachedTail = 0;
+	}
+
+	// producer only, returns false if the queue is full
+	bool push(const T &value) {
+		std::size_t currentTail = tail.load(std::memory_order_relaxed);
+
+		if (currentTail - cachedHead > mask) {
+			cachedHead = head.load(std::memory_order_acquire);
+			if (currentTail - cachedHead > mask) {
+				return false;
+			}
+		}
+
+		slots[currentTail & mask] = value;
+		tail.store(currentTail + 1, std::memory_order_release);
+		return true;
+	}
+
+	// consumer only, returns false if the queue is empty
+	bool pop(T &value) {
+		std::size_t currentHead = head.load(std::memory_order_relaxed);
+
+		if (currentHead == cachedTail) {
+			cachedTail = tail.load(std::memory_order_acquire);
+			if (currentHead == cachedTail) {
+				return false;
+			}
+		}
+
+		value = slots[currentHead & mask];
+		head.store(currentHead + 1, std::memory_order_release);
+		return true;
+	}
+
+	// only a hint while the other side is running
+	bool empty() {
+		return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+	}
+
+	std::size_t capacity() {
+		return mask + 1;
+	}
+
+private:
+	std::vector<T> slots;
+	std::size_t mask;
+
+	// next slot to pop, written by the consumer
+	alignas(64) std::atomic<std::size_t> head;
+	std::size_t cachedTail;
+
+	// next slot to push, written by the producer
+	alignas(64) std::atomic<std::size_t> tail;
+	std::size_t cachedHead;
+};
@@ -0,0 +1,611 @@
+#include "StencilKernels.h"
+
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define STENCIL_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(STENCIL_X86) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// msvc lets any function use the avx intrinsics, gcc and clang need the instruction set enabled per function
+// gcc would also fuse the separate multiplies and adds into fma once avx-512 is enabled, which changes the rounding
+#if defined(_MSC_VER) && !defined(__clang__)
+#define SIMD_TARGET(isa)
+#elif defined(__clang__)
+#define SIMD_TARGET(isa) __attribute__((target(isa)))
+#else
+#define SIMD_TARGET(isa) __attribute__((target(isa), optimize("fp-contract=off")))
+#endif
+
+// linear [0, 1] in SRGB_STEPS steps to the srgb byte, with 3 bytes of padding so the vector kernels can gather 32 bits at a time
+static const int SRGB_STEPS = 65535;
+
+static const unsigned char* srgbTable() {
+	static const std::vector<unsigned char> table = [] {
+		std::vector<unsigned char> table(SRGB_STEPS + 1 + 3, 0);
+		for (int i = 0; i <= SRGB_STEPS; i++) {
+			double linear = double(i) / SRGB_STEPS;
+			double encoded = linear <= 0.0031308 ? 12.92 * linear : 1.055 * std::pow(linear, 1.0 / 2.4) - 0.055;
+			table[i] = (unsigned char)(encoded * 255.0 + 0.5);
+		}
+		return table;
+	}();
+
+	return table.data();
+}
+
+// scalar
+
+static void relaxRowScalar(float* row, const float* up, const float* down, const float* prev, float a, float cRecip, int xStart, int xEnd) {
+	for (int x = xStart; x < xEnd; x += 2) {
+		row[x] = (prev[x] +
+			a * (
+				down[x] +
+				up[x] +
+				row[x + 1] +
+				row[x - 1]
+				)
+			) * cRecip;
+	}
+}
+
+static void divergenceRowScalar(float* div, const float* vx, const float* vyUp, const float* vyDown, float size, int xStart, int xEnd) {
+	for (int x = xStart; x < xEnd; x++) {
+		div[x] = -0.5f*(
+			  vx[x+1]
+			- vx[x-1]
+			+ vyDown[x]
+			- vyUp[x]
+			) / size;
+	}
+}
+
+static void gradientRowScalar(float* vx, float* vy, const float* p, const float* pUp, const float* pDown, float size, int xStart, int xEnd) {
+	for (int x = xStart; x < xEnd; x++) {
+		vx[x] -= 0.5f * (p[x+1] - p[x-1]) * size;
+		vy[x] -= 0.5f * (pDown[x] - pUp[x]) * size;
+	}
+}
+
+static void fadeRowScalar(float* row, float decrement, float low, float high, int count) {
+	for (int x = 0; x < count; x++) {
+		float value = row[x] - decrement;
+		if (value < low) {
+			value = low;
+		}
+		if (value > high) {
+			value = high;
+		}
+		row[x] = value;
+	}
+}
+
+static void splatRowScalar(float* red, float* green, float* blue, const float* amount, float r, float g, float b, int count) {
+	for (int x = 0; x < count; x++) {
+		red[x] += amount[x] * r / 255.0f;
+		green[x] += amount[x] * g / 255.0f;
+		blue[x] += amount[x] * b / 255.0f;
+	}
+}
+
+static void addRowScalar(float* row, float value, int count) {
+	for (int x = 0; x < count; x++) {
+		row[x] += value;
+	}
+}
+
+// bit for bit what the f16c conversion gives
+static unsigned short floatToHalf(float value) {
+	unsigned int bits;
+	memcpy(&bits, &value, sizeof(bits));
+
+	unsigned int sign = (bits >> 16) & 0x8000;
+	unsigned int magnitude = bits & 0x7FFFFFFF;
+
+	// nan keeps the top of its payload and is made quiet
+	if (magnitude > 0x7F800000) {
+		return sign | 0x7E00 | ((magnitude >> 13) & 0x3FF);
+	}
+
+	// 65520 and up rounds past the largest half
+	if (magnitude >= 0x477FF000) {
+		return sign | 0x7C00;
+	}
+
+	// normal halves, rebias the exponent and round the 13 dropped bits to nearest even
+	if (magnitude >= 0x38800000) {
+		unsigned int rounded = magnitude + 0xFFF + ((magnitude >> 13) & 1);
+		return sign | ((rounded - 0x38000000) >> 13);
+	}
+
+	// up to half the smallest subnormal rounds to zero
+	if (magnitude <= 0x33000000) {
+		return sign;
+	}
+
+	// subnormal halves, the mantissa with its implicit bit shifted down to units of 2^-24
+	unsigned int exponent = magnitude >> 23;
+	unsigned int mantissa = (magnitude & 0x7FFFFF) | 0x800000;
+	unsigned int shift = 126 - exponent;
+
+	unsigned int half = mantissa >> shift;
+	unsigned int remainder = mantissa & ((1u << shift) - 1);
+	unsigned int halfway = 1u << (shift - 1);
+	if (remainder > halfway || (remainder == halfway && (half & 1))) {
+		half++;
+	}
+
+	return sign | half;
+}
+
+static void halfRowScalar(unsigned short* out, const float* in, int count) {
+	for (int x = 0; x < count; x++) {
+		out[x] = floatToHalf(in[x]);
+	}
+}
+
+static void srgbRowScalar(unsigned char* out, const float* in, int count) {
+	const unsigned char* table = srgbTable();
+
+	for (int x = 0; x < count; x++) {
+		// written the way the vector max and min compare so nan goes to 0 on every level
+		float value = in[x] > 0.0f ? in[x] : 0.0f;
+		value = value < 1.0f ? value : 1.0f;
+
+		out[x] = table[int(value * float(SRGB_STEPS) + 0.5f)];
+	}
+}
+
+#ifdef STENCIL_X86
+
+// avx2, 8 cells at a time with the leftovers done by the scalar kernels
+// the upper halves are cleared before falling back since sse code after dirty ymm registers is slow on intel
+
+SIMD_TARGET("avx2")
+static void relaxRowAvx2(float* row, const float* up, const float* down, const float* prev, float a, float cRecip, int xStart, int xEnd) {
+	__m256 av = _mm256_set1_ps(a);
+	__m256 cv = _mm256_set1_ps(cRecip);
+
+	// every vector starts on a cell of this colour so only the even lanes are stored
+	// a masked store leaves the other colour alone for the neighbouring rows reading it on other threads,
+	// and the rows above and below are only read in the even lanes too, their odd lanes are being written by those threads
+	__m256i colour = _mm256_setr_epi32(-1, 0, -1, 0, -1, 0, -1, 0);
+
+	int x = xStart;
+	if (x + 8 > xEnd) {
+		relaxRowScalar(row, up, down, prev, a, cRecip, x, xEnd);
+		return;
+	}
+
+	__m256 left = _mm256_loadu_ps(row + x - 1);
+	__m256 right = _mm256_loadu_ps(row + x + 1);
+
+	for (; x + 8 <= xEnd; x += 8) {
+		__m256 sum = _mm256_add_ps(_mm256_maskload_ps(down + x, colour), _mm256_maskload_ps(up + x, colour));
+		sum = _mm256_add_ps(sum, right);
+		sum = _mm256_add_ps(sum, left);
+
+		__m256 result = _mm256_mul_ps(_mm256_add_ps(_mm256_loadu_ps(prev + x), _mm256_mul_ps(av, sum)), cv);
+
+		// the next neighbours overlap this store, loading them after it would stall on store forwarding
+		if (x + 16 <= xEnd) {
+			left = _mm256_loadu_ps(row + x + 7);
+			right = _mm256_loadu_ps(row + x + 9);
+		}
+
+		_mm256_maskstore_ps(row + x, colour, result);
+	}
+
+	_mm256_zeroupper();
+	relaxRowScalar(row, up, down, prev, a, cRecip, x, xEnd);
+}
+
+SIMD_TARGET("avx2")
+static void divergenceRowAvx2(float* div, const float* vx, const float* vyUp, const float* vyDown, float size, int xStart, int xEnd) {
+	__m256 half = _mm256_set1_ps(-0.5f);
+	__m256 sv = _mm256_set1_ps(size);
+
+	int x = xStart;
+	for (; x + 8 <= xEnd; x += 8) {
+		__m256 sum = _mm256_sub_ps(_mm256_loadu_ps(vx + x + 1), _mm256_loadu_ps(vx + x - 1));
+		sum = _mm256_add_ps(sum, _mm256_loadu_ps(vyDown + x));
+		sum = _mm256_sub_ps(sum, _mm256_loadu_ps(vyUp + x));
+
+		_mm256_storeu_ps(div + x, _mm256_div_ps(_mm256_mul_ps(half, sum), sv));
+	}
+
+	_mm256_zeroupper();
+	divergenceRowScalar(div, vx, vyUp, vyDown, size, x, xEnd);
+}
+
+SIMD_TARGET("avx2")
+static void gradientRowAvx2(float* vx, float* vy, const float* p, const float* pUp, const float* pDown, float size, int xStart, int xEnd) {
+	__m256 half = _mm256_set1_ps(0.5f);
+	__m256 sv = _mm256_set1_ps(size);
+
+	int x = xStart;
+	for (; x + 8 <= xEnd; x += 8) {
+		__m256 dx = _mm256_mul_ps(_mm256_mul_ps(half, _mm256_sub_ps(_mm256_loadu_ps(p + x + 1), _mm256_loadu_ps(p + x - 1))), sv);
+		__m256 dy = _mm256_mul_ps(_mm256_mul_ps(half, _mm256_sub_ps(_mm256_loadu_ps(pDown + x), _mm256_loadu_ps(pUp + x))), sv);
+
+		_mm256_storeu_ps(vx + x, _mm256_sub_ps(_mm256_loadu_ps(vx + x), dx));
+		_mm256_storeu_ps(vy + x, _mm256_sub_ps(_mm256_loadu_ps(vy + x), dy));
+	}
+
+	_mm256_zeroupper();
+	gradientRowScalar(vx, vy, p, pUp, pDown, size, x, xEnd);
+}
+
+SIMD_TARGET("avx2")
+static void fadeRowAvx2(float* row, float decrement, float low, float high, int count) {
+	__m256 dv = _mm256_set1_ps(decrement);
+	__m256 lv = _mm256_set1_ps(low);
+	__m256 hv = _mm256_set1_ps(high);
+
+	int x = 0;
+	for (; x + 8 <= count; x += 8) {
+		__m256 value = _mm256_sub_ps(_mm256_loadu_ps(row + x), dv);
+
+		// operand order keeps nan passing through the same way the scalar compares do
+		value = _mm256_max_ps(lv, value);
+		value = _mm256_min_ps(hv, value);
+
+		_mm256_storeu_ps(row + x, value);
+	}
+
+	_mm256_zeroupper();
+	fadeRowScalar(row + x, decrement, low, high, count - x);
+}
+
+SIMD_TARGET("avx2")
+static void splatRowAvx2(float* red, float* green, float* blue, const float* amount, float r, float g, float b, int count) {
+	__m256 rv = _mm256_set1_ps(r);
+	__m256 gv = _mm256_set1_ps(g);
+	__m256 bv = _mm256_set1_ps(b);
+	__m256 scale = _mm256_set1_ps(255.0f);
+
+	int x = 0;
+	for (; x + 8 <= count; x += 8) {
+		__m256 a = _mm256_loadu_ps(amount + x);
+
+		_mm256_storeu_ps(red + x, _mm256_add_ps(_mm256_loadu_ps(red + x), _mm256_div_ps(_mm256_mul_ps(a, rv), scale)));
+		_mm256_storeu_ps(green + x, _mm256_add_ps(_mm256_loadu_ps(green + x), _mm256_div_ps(_mm256_mul_ps(a, gv), scale)));
+		_mm256_storeu_ps(blue + x, _mm256_add_ps(_mm256_loadu_ps(blue + x), _mm256_div_ps(_mm256_mul_ps(a, bv), scale)));
+	}
+
+	_mm256_zeroupper();
+	splatRowScalar(red + x, green + x, blue + x, amount + x, r, g, b, count - x);
+}
+
+SIMD_TARGET("avx2")
+static void addRowAvx2(float* row, float value, int count) {
+	__m256 vv = _mm256_set1_ps(value);
+
+	int x = 0;
+	for (; x + 8 <= count; x += 8) {
+		_mm256_storeu_ps(row + x, _mm256_add_ps(_mm256_loadu_ps(row + x), vv));
+	}
+
+	_mm256_zeroupper();
+	addRowScalar(row + x, value, count - x);
+}
+
+// every avx2 cpu has f16c as well, detect checks for it
+SIMD_TARGET("avx2,f16c")
+static void halfRowAvx2(unsigned short* out, const float* in, int count) {
+	int x = 0;
+	for (; x + 8 <= count; x += 8) {
+		_mm_storeu_si128((__m128i*)(out + x), _mm256_cvtps_ph(_mm256_loadu_ps(in + x), _MM_FROUND_TO_NEAREST_INT));
+	}
+
+	_mm256_zeroupper();
+	halfRowScalar(out + x, in + x, count - x);
+}
+
+SIMD_TARGET("avx2")
+static void srgbRowAvx2(unsigned char* out, const float* in, int count) {
+	const unsigned char* table = srgbTable();
+
+	__m256 zero = _mm256_setzero_ps();
+	__m256 one = _mm256_set1_ps(1.0f);
+	__m256 steps = _mm256_set1_ps(float(SRGB_STEPS));
+	__m256 half = _mm256_set1_ps(0.5f);
+
+	// the low byte of each 32 bit lane to the front of its 128 bit half, then the two halves next to each other
+	__m256i lowBytes = _mm256_setr_epi8(
+		0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+		0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+	__m256i joinHalves = _mm256_setr_epi32(0, 4, 0, 0, 0, 0, 0, 0);
+
+	int x = 0;
+	for (; x + 8 <= count; x += 8) {
+		__m256 value = _mm256_max_ps(_mm256_loadu_ps(in + x), zero);
+		value = _mm256_min_ps(value, one);
+
+		__m256i index = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(value, steps), half));
+		__m256i bytes = _mm256_i32gather_epi32((const int*)table, index, 1);
+
+		bytes = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(bytes, lowBytes), joinHalves);
+		_mm_storel_epi64((__m128i*)(out + x), _mm256_castsi256_si128(bytes));
+	}
+
+	_mm256_zeroupper();
+	srgbRowScalar(out + x, in + x, count - x);
+}
+
+// avx-512, 16 cells at a time with the leftovers masked off
+
+SIMD_TARGET("avx512f")
+static __mmask16 remainingLanes(int remaining) {
+	if (remaining <= 0) {
+		return 0;
+	}
+	return remaining >= 16 ? __mmask16(0xFFFF) : __mmask16((1u << remaining) - 1);
+}
+
+SIMD_TARGET("avx512f")
+static void relaxRowAvx512(float* row, const float* up, const float* down, const float* prev, float a, float cRecip, int xStart, int xEnd) {
+	__m512 av = _mm512_set1_ps(a);
+	__m512 cv = _mm512_set1_ps(cRecip);
+
+	// even lanes are this colour
+	__mmask16 lanes = remainingLanes(xEnd - xStart) & __mmask16(0x5555);
+
+	__m512 left = _mm512_maskz_loadu_ps(lanes, row + xStart - 1);
+	__m512 right = _mm512_maskz_loadu_ps(lanes, row + xStart + 1);
+
+	for (int x = xStart; x < xEnd; x += 16) {
+		__m512 sum = _mm512_add_ps(_mm512_maskz_loadu_ps(lanes, down + x), _mm512_maskz_loadu_ps(lanes, up + x));
+		sum = _mm512_add_ps(sum, right);
+		sum = _mm512_add_ps(sum, left);
+
+		__m512 result = _mm512_mul_ps(_mm512_add_ps(_mm512_maskz_loadu_ps(lanes, prev + x), _mm512_mul_ps(av, sum)), cv);
+
+		// same as avx2, get the overlapping neighbours for the next block in before the store
+		__mmask16 nextLanes = remainingLanes(xEnd - x - 16) & __mmask16(0x5555);
+		left = _mm512_maskz_loadu_ps(nextLanes, row + x + 15);
+		right = _mm512_maskz_loadu_ps(nextLanes, row + x + 17);
+
+		_mm512_mask_storeu_ps(row + x, lanes, result);
+		lanes = nextLanes;
+	}
+}
+
+SIMD_TARGET("avx512f")
+static void divergenceRowAvx512(float* div, const float* vx, const float* vyUp, const float* vyDown, float size, int xStart, int xEnd) {
+	__m512 half = _mm512_set1_ps(-0.5f);
+	__m512 sv = _mm512_set1_ps(size);
+
+	for (int x = xStart; x < xEnd; x += 16) {
+		__mmask16 lanes = remainingLanes(xEnd - x);
+
+		__m512 sum = _mm512_sub_ps(_mm512_maskz_loadu_ps(lanes, vx + x + 1), _mm512_maskz_loadu_ps(lanes, vx + x - 1));
+		sum = _mm512_add_ps(sum, _mm512_maskz_loadu_ps(lanes, vyDown + x));
+		sum = _mm512_sub_ps(sum, _mm512_maskz_loadu_ps(lanes, vyUp + x));
+
+		_mm512_mask_storeu_ps(div + x, lanes, _mm512_div_ps(_mm512_mul_ps(half, sum), sv));
+	}
+}
+
+SIMD_TARGET("avx512f")
+static void gradientRowAvx512(float* vx, float* vy, const float* p, const float* pUp, const float* pDown, float size, int xStart, int xEnd) {
+	__m512 half = _mm512_set1_ps(0.5f);
+	__m512 sv = _mm512_set1_ps(size);
+
+	for (int x = xStart; x < xEnd; x += 16) {
+		__mmask16 lanes = remainingLanes(xEnd - x);
+
+		__m512 dx = _mm512_mul_ps(_mm512_mul_ps(half, _mm512_sub_ps(_mm512_maskz_loadu_ps(lanes, p + x + 1), _mm512_maskz_loadu_ps(lanes, p + x - 1))), sv);
+		__m512 dy = _mm512_mul_ps(_mm512_mul_ps(half, _mm512_sub_ps(_mm512_maskz_loadu_ps(lanes, pDown + x), _mm512_maskz_loadu_ps(lanes, pUp + x))), sv);
+
+		_mm512_mask_storeu_ps(vx + x, lanes, _mm512_sub_ps(_mm512_maskz_loadu_ps(lanes, vx + x), dx));
+		_mm512_mask_storeu_ps(vy + x, lanes, _mm512_sub_ps(_mm512_maskz_loadu_ps(lanes, vy + x), dy));
+	}
+}
+
+SIMD_TARGET("avx512f")
+static void fadeRowAvx512(float* row, float decrement, float low, float high, int count) {
+	__m512 dv = _mm512_set1_ps(decrement);
+	__m512 lv = _mm512_set1_ps(low);
+	__m512 hv = _mm512_set1_ps(high);
+
+	for (int x = 0; x < count; x += 16) {
+		__mmask16 lanes = remainingLanes(count - x);
+
+		__m512 value = _mm512_sub_ps(_mm512_maskz_loadu_ps(lanes, row + x), dv);
+		value = _mm512_max_ps(lv, value);
+		value = _mm512_min_ps(hv, value);
+
+		_mm512_mask_storeu_ps(row + x, lanes, value);
+	}
+}
+
+SIMD_TARGET("avx512f")
+static void splatRowAvx512(float* red, float* green, float* blue, const float* amount, float r, float g, float b, int count) {
+	__m512 rv = _mm512_set1_ps(r);
+	__m512 gv = _mm512_set1_ps(g);
+	__m512 bv = _mm512_set1_ps(b);
+	__m512 scale = _mm512_set1_ps(255.0f);
+
+	for (int x = 0; x < count; x += 16) {
+		__mmask16 lanes = remainingLanes(count - x);
+
+		__m512 a = _mm512_maskz_loadu_ps(lanes, amount + x);
+
+		_mm512_mask_storeu_ps(red + x, lanes, _mm512_add_ps(_mm512_maskz_loadu_ps(lanes, red + x), _mm512_div_ps(_mm512_mul_ps(a, rv), scale)));
+		_mm512_mask_storeu_ps(green + x, lanes, _mm512_add_ps(_mm512_maskz_loadu_ps(lanes, green + x), _mm512_div_ps(_mm512_mul_ps(a, gv), scale)));
+		_mm512_mask_storeu_ps(blue + x, lanes, _mm512_add_ps(_mm512_maskz_loadu_ps(lanes, blue + x), _mm512_div_ps(_mm512_mul_ps(a, bv), scale)));
+	}
+}
+
+SIMD_TARGET("avx512f")
+static void addRowAvx512(float* row, float value, int count) {
+	__m512 vv = _mm512_set1_ps(value);
+
+	for (int x = 0; x < count; x += 16) {
+		__mmask16 lanes = remainingLanes(count - x);
+
+		_mm512_mask_storeu_ps(row + x, lanes, _mm512_add_ps(_mm512_maskz_loadu_ps(lanes, row + x), vv));
+	}
+}
+
+SIMD_TARGET("avx512f")
+static void halfRowAvx512(unsigned short* out, const float* in, int count) {
+	for (int x = 0; x < count; x += 16) {
+		__mmask16 lanes = remainingLanes(count - x);
+
+		__m256i halves = _mm512_cvtps_ph(_mm512_maskz_loadu_ps(lanes, in + x), _MM_FROUND_TO_NEAREST_INT);
+
+		// 16 bit lanes need avx512bw to mask so the tail goes through the scalar kernel instead
+		if (lanes == 0xFFFF) {
+			_mm256_storeu_si256((__m256i*)(out + x), halves);
+		}
+		else {
+			halfRowScalar(out + x, in + x, count - x);
+		}
+	}
+}
+
+SIMD_TARGET("avx512f")
+static void srgbRowAvx512(unsigned char* out, const float* in, int count) {
+	const unsigned char* table = srgbTable();
+
+	__m512 zero = _mm512_setzero_ps();
+	__m512 one = _mm512_set1_ps(1.0f);
+	__m512 steps = _mm512_set1_ps(float(SRGB_STEPS));
+	__m512 half = _mm512_set1_ps(0.5f);
+
+	for (int x = 0; x < count; x += 16) {
+		__mmask16 lanes = remainingLanes(count - x);
+
+		__m512 value = _mm512_max_ps(_mm512_maskz_loadu_ps(lanes, in + x), zero);
+		value = _mm512_min_ps(value, one);
+
+		__m512i index = _mm512_cvttps_epi32(_mm512_add_ps(_mm512_mul_ps(value, steps), half));
+		__m512i bytes = _mm512_mask_i32gather_epi32(_mm512_setzero_si512(), lanes, index, table, 1);
+
+		_mm512_mask_cvtepi32_storeu_epi8(out + x, lanes, bytes);
+	}
+}
+
+#endif
+
+StencilKernels::StencilKernels() {
+	level = SimdLevel::SCALAR;
+	relaxRow = relaxRowScalar;
+	divergenceRow = divergenceRowScalar;
+	gradientRow = gradientRowScalar;
+	fadeRow = fadeRowScalar;
+	splatRow = splatRowScalar;
+	addRow = addRowScalar;
+	halfRow = halfRowScalar;
+	srgbRow = srgbRowScalar;
+
+	select(detect());
+}
+
+bool StencilKernels::select(SimdLevel level) {
+	if (level > detect()) {
+		return false;
+	}
+
+	this->level = level;
+
+	switch (level) {
+#ifdef STENCIL_X86
+	case SimdLevel::AVX512:
+		relaxRow = relaxRowAvx512;
+		divergenceRow = divergenceRowAvx512;
+		gradientRow = gradientRowAvx512;
+		fadeRow = fadeRowAvx512;
+		splatRow = splatRowAvx512;
+		addRow = addRowAvx512;
+		halfRow = halfRowAvx512;
+		srgbRow = srgbRowAvx512;
+		break;
+	case SimdLevel::AVX2:
+		relaxRow = relaxRowAvx2;
+		divergenceRow = divergenceRowAvx2;
+		gradientRow = gradientRowAvx2;
+		fadeRow = fadeRowAvx2;
+		splatRow = splatRowAvx2;
+		addRow = addRowAvx2;
+		halfRow = halfRowAvx2;
+		srgbRow = srgbRowAvx2;
+		break;
+#endif
+	default:
+		relaxRow = relaxRowScalar;
+		divergenceRow = divergenceRowScalar;
+		gradientRow = gradientRowScalar;
+		fadeRow = fadeRowScalar;
+		splatRow = splatRowScalar;
+		addRow = addRowScalar;
+		halfRow = halfRowScalar;
+		srgbRow = srgbRowScalar;
+		break;
+	}
+
+	return true;
+}
+
+SimdLevel StencilKernels::detect() {
+#if defined(STENCIL_X86) && defined(_MSC_VER)
+	int info[4];
+
+	__cpuid(info, 0);
+	if (info[0] < 7) {
+		return SimdLevel::SCALAR;
+	}
+
+	// the os has to save the ymm (and for avx-512 the zmm and mask) registers too, not just the cpu support them
+	__cpuid(info, 1);
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	bool f16c = (info[2] & (1 << 29)) != 0;
+	if (!osxsave) {
+		return SimdLevel::SCALAR;
+	}
+	unsigned long long xcr0 = _xgetbv(0);
+
+	__cpuidex(info, 7, 0);
+	bool avx2 = (info[1] & (1 << 5)) != 0 && f16c && (xcr0 & 0x6) == 0x6;
+	bool avx512 = (info[1] & (1 << 16)) != 0 && (xcr0 & 0xE6) == 0xE6;
+
+	if (avx512) {
+		return SimdLevel::AVX512;
+	}
+	if (avx2) {
+		return SimdLevel::AVX2;
+	}
+	return SimdLevel::SCALAR;
+#elif defined(STENCIL_X86)
+	// these already check that the os has enabled the registers
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f")) {
+		return SimdLevel::AVX512;
+	}
+	if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("f16c")) {
+		return SimdLevel::AVX2;
+	}
+	return SimdLevel::SCALAR;
+#else
+	return SimdLevel::SCALAR;
+#endif
+}
+
+const char* StencilKernels::name(SimdLevel level) {
+	switch (level) {
+	case SimdLevel::AVX512:
+		return "avx512";
+	case SimdLevel::AVX2:
+		return "avx2";
+	default:
+		return "scalar";
+	}
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+// which instruction set the row kernels run on
+enum SimdLevel { SCALAR = 0, AVX2 = 1, AVX512 = 2 };
+
+// Row kernels for the streaming stencils in FluidBox (red-black relaxation, divergence, pressure gradient, the fade clamp
+// and the brush) and for converting the density the viewer uploads.
+// Each one has a scalar version and explicit AVX2 / AVX-512 versions, the best one the cpu supports is picked at runtime.
+// The vector versions do the same float operations in the same order as the scalar ones (no fused multiply-add)
+// so the simulation gives identical results on every level.
+class StencilKernels {
+public:
+	SimdLevel level;
+
+	// starts on the best level the cpu supports
+	StencilKernels();
+
+	// switches to level, returns false and keeps the current kernels if the cpu can't run it
+	bool select(SimdLevel level);
+
+	// highest level this cpu (and os) can run
+	static SimdLevel detect();
+
+	static const char* name(SimdLevel level);
+
+	// row[x] = (prev[x] + a * (down[x] + up[x] + row[x + 1] + row[x - 1])) * cRecip for x = xStart, xStart + 2, ... < xEnd
+	void (*relaxRow)(float* row, const float* up, const float* down, const float* prev, float a, float cRecip, int xStart, int xEnd);
+
+	// div[x] = -0.5 * (vx[x + 1] - vx[x - 1] + vyDown[x] - vyUp[x]) / size for x in [xStart, xEnd)
+	void (*divergenceRow)(float* div, const float* vx, const float* vyUp, const float* vyDown, float size, int xStart, int xEnd);
+
+	// vx[x] -= 0.5 * (p[x + 1] - p[x - 1]) * size and vy[x] -= 0.5 * (pDown[x] - pUp[x]) * size for x in [xStart, xEnd)
+	void (*gradientRow)(float* vx, float* vy, const float* p, const float* pUp, const float* pDown, float size, int xStart, int xEnd);
+
+	// row[x] = clamp(row[x] - decrement, low, high) for x in [0, count)
+	void (*fadeRow)(float* row, float decrement, float low, float high, int count);
+
+	// red[x] += amount[x] * r / 255 (and the same for green and blue) for x in [0, count)
+	void (*splatRow)(float* red, float* green, float* blue, const float* amount, float r, float g, float b, int count);
+
+	// row[x] += value for x in [0, count)
+	void (*addRow)(float* row, float value, int count);
+
+	// out[x] = in[x] as a half float (rounded to nearest even, nan stays nan) for x in [0, count)
+	void (*halfRow)(unsigned short* out, const float* in, int count);
+
+	// out[x] = in[x] clamped to [0, 1] and encoded with the srgb curve to 8 bits for x in [0, count)
+	// looked up in a table of 65536 steps so every level gives the same byte
+	void (*srgbRow)(unsigned char* out, const float* in, int count);
+};
@@ -0,0 +1,207 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+// how many times an idle worker checks for a new job before going to sleep
+// the solvers post jobs back to back so most of them get picked up without a trip through the condition variable
+static const int SPIN_COUNT = 2000;
+
+static unsigned long long packRange(int first, int last) {
+	return (static_cast<unsigned long long>(static_cast<unsigned int>(first)) << 32) | static_cast<unsigned int>(last);
+}
+
+static int rangeFirst(unsigned long long range) {
+	return int(range >> 32);
+}
+
+static int rangeLast(unsigned long long range) {
+	return int(range & 0xFFFFFFFFull);
+}
+
+ThreadPool::ThreadPool(int threadCount) {
+	if (threadCount <= 0) {
+		threadCount = std::max(1, int(std::thread::hardware_concurrency()));
+	}
+
+	task = nullptr;
+	jobBegin = 0;
+	jobEnd = 0;
+	tileSize = 1;
+	tileCount = 0;
+
+	completedTiles.store(0);
+
+	activeWorkers = 0;
+	generation.store(0);
+	stopping = false;
+
+	deques.reset(new TileDeque[threadCount]);
+	for (int i = 0; i < threadCount; i++) {
+		deques[i].range.store(0);
+	}
+
+	// the caller works too (as thread 0) so only spawn the extra threads
+	for (int i = 1; i < threadCount; i++) {
+		workers.push_back(std::thread(&ThreadPool::workerLoop, this, i));
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+
+	for (int i = 0; i < workers.size(); i++) {
+		workers[i].join();
+	}
+}
+
+int ThreadPool::getThreadCount() {
+	return int(workers.size()) + 1;
+}
+
+void ThreadPool::parallelFor(int begin, int end, const std::function<void(int, int)> &task) {
+	if (end <= begin) {
+		return;
+	}
+
+	// nothing to share the work with
+	if (workers.empty()) {
+		task(begin, end);
+		return;
+	}
+
+	int threadCount = getThreadCount();
+
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+
+		// a worker that woke up late for the previous job may still be reading it
+		done.wait(lock, [this] { return activeWorkers == 0; });
+
+		// enough tiles per thread that stealing can even out uneven rows
+		int targetTiles = threadCount * 8;
+
+		this->task = &task;
+		jobBegin = begin;
+		jobEnd = end;
+		tileSize = std::max(1, (end - begin + targetTiles - 1) / targetTiles);
+		tileCount = (end - begin + tileSize - 1) / tileSize;
+
+		// neighbouring tiles go to the same thread so every pass over a grid touches the same rows on the same core
+		for (int i = 0; i < threadCount; i++) {
+			int first = int((long long)tileCount * i / threadCount);
+			int last = int((long long)tileCount * (i + 1) / threadCount);
+			deques[i].range.store(packRange(first, last));
+		}
+
+		completedTiles.store(0);
+
+		generation.fetch_add(1);
+	}
+	wake.notify_all();
+
+	runTiles(0);
+
+	std::unique_lock<std::mutex> lock(mutex);
+	done.wait(lock, [this] { return completedTiles.load() == tileCount && activeWorkers == 0; });
+	this->task = nullptr;
+}
+
+void ThreadPool::workerLoop(int index) {
+	unsigned long long seenGeneration = 0;
+
+	while (true) {
+		for (int spin = 0; spin < SPIN_COUNT && generation.load() == seenGeneration; spin++) {
+			std::this_thread::yield();
+		}
+
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [&] { return stopping || generation.load() != seenGeneration; });
+
+			if (stopping) {
+				return;
+			}
+
+			seenGeneration = generation.load();
+			activeWorkers++;
+		}
+
+		runTiles(index);
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			activeWorkers--;
+		}
+		done.notify_all();
+	}
+}
+
+// works through this thread's own tiles and then keeps stealing until every deque is empty
+void ThreadPool::runTiles(int index) {
+	while (true) {
+		int tile;
+		while (popTile(index, tile)) {
+			int tileBegin = jobBegin + tile * tileSize;
+			int tileEnd = std::min(jobEnd, tileBegin + tileSize);
+
+			(*task)(tileBegin, tileEnd);
+
+			completedTiles.fetch_add(1);
+		}
+
+		if (!stealTiles(index)) {
+			return;
+		}
+	}
+}
+
+bool ThreadPool::popTile(int index, int &tile) {
+	std::atomic<unsigned long long> &range = deques[index].range;
+	unsigned long long current = range.load();
+
+	while (true) {
+		int first = rangeFirst(current);
+		int last = rangeLast(current);
+
+		if (first >= last) {
+			return false;
+		}
+
+		if (range.compare_exchange_weak(current, packRange(first + 1, last))) {
+			tile = first;
+			return true;
+		}
+	}
+}
+
+// moves half of the tiles left on the first busy deque after this thread's onto its own deque
+// only called once this thread's deque is empty so nobody else is touching it
+bool ThreadPool::stealTiles(int index) {
+	int threadCount = getThreadCount();
+
+	for (int offset = 1; offset < threadCount; offset++) {
+		std::atomic<unsigned long long> &victim = deques[(index + offset) % threadCount].range;
+		unsigned long long current = victim.load();
+
+		while (true) {
+			int first = rangeFirst(current);
+			int last = rangeLast(current);
+
+			if (first >= last) {
+				break;
+			}
+
+			int stolen = (last - first + 1) / 2;
+			if (victim.compare_exchange_weak(current, packRange(first, last - stolen))) {
+				deques[index].range.store(packRange(last - stolen, last));
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of worker threads that stay alive for the life of the pool.
+// The calling thread always takes part in the work so a pool of n threads only spawns n - 1 workers.
+// parallelFor cuts its range into tiles and deals each thread a contiguous block of them on its own deque,
+// a thread that runs out steals half of the tiles left on another thread's deque.
+class ThreadPool {
+public:
+	// 0 picks the number of hardware threads
+	ThreadPool(int threadCount = 0);
+	~ThreadPool();
+
+	int getThreadCount();
+
+	// splits [begin, end) into tiles and runs task(tileBegin, tileEnd) on each of them across the pool
+	// returns once every tile has finished
+	void parallelFor(int begin, int end, const std::function<void(int, int)> &task);
+
+private:
+	// tiles [first, last) still waiting on one thread, packed into one word so taking and stealing are a single compare and swap
+	// the owner takes tiles from the front and thieves take them from the back
+	struct alignas(64) TileDeque {
+		std::atomic<unsigned long long> range;
+	};
+
+	std::vector<std::thread> workers;
+	std::unique_ptr<TileDeque[]> deques;
+
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+
+	// current job (only written while no worker is active)
+	const std::function<void(int, int)>* task;
+	int jobBegin;
+	int jobEnd;
+	int tileSize;
+	int tileCount;
+
+	std::atomic<int> completedTiles;
+
+	int activeWorkers;
+	std::atomic<unsigned long long> generation;
+	bool stopping;
+
+	void workerLoop(int index);
+	void runTiles(int index);
+
+	bool popTile(int index, int &tile);
+	bool stealTiles(int index);
+};
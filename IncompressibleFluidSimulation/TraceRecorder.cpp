@@ -0,0 +1,184 @@
+#include "TraceRecorder.h"
+
+#include <cstdio>
+#include <cstring>
+
+using namespace std;
+
+// how often the writer drains the ring when it isn't filling up
+static const chrono::milliseconds FLUSH_INTERVAL(100);
+
+TraceRecorder traceRecorder;
+
+TraceRecorder::TraceRecorder() {
+	recording.store(false);
+	head = 0;
+	count = 0;
+	droppedSpans = 0;
+	firstEvent = true;
+	stopping = false;
+}
+
+TraceRecorder::~TraceRecorder() {
+	stop();
+}
+
+bool TraceRecorder::start(string path) {
+	stop();
+
+	file.open(path);
+	if (!file) {
+		file.clear();
+		return false;
+	}
+
+	{
+		lock_guard<std::mutex> lock(mutex);
+		ring = vector<Span>(CAPACITY);
+		head = 0;
+		count = 0;
+		droppedSpans = 0;
+		firstEvent = true;
+		stopping = false;
+		origin = chrono::steady_clock::now();
+	}
+
+	file << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+
+	writer = thread(&TraceRecorder::writerLoop, this);
+	recording.store(true);
+
+	return true;
+}
+
+void TraceRecorder::stop() {
+	if (!writer.joinable()) {
+		return;
+	}
+
+	recording.store(false);
+
+	{
+		lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+	writer.join();
+
+	// thread names go last, the viewer doesn't care about the order of events
+	lock_guard<std::mutex> lock(mutex);
+	for (map<int, string>::iterator it = threadNames.begin(); it != threadNames.end(); it++) {
+		writeEvent("{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " + to_string(it->first) + ", \"args\": {\"name\": \"" + it->second + "\"}}");
+	}
+
+	file << "\n]}\n";
+	file.close();
+
+	ring.clear();
+	ring.shrink_to_fit();
+}
+
+void TraceRecorder::setThreadName(string name) {
+	int index = threadIndex();
+
+	lock_guard<std::mutex> lock(mutex);
+	threadNames[index] = name;
+}
+
+void TraceRecorder::addSpan(const char* name, chrono::steady_clock::time_point start, chrono::steady_clock::time_point end) {
+	Span span;
+	strncpy(span.name, name, sizeof(span.name) - 1);
+	span.name[sizeof(span.name) - 1] = '\0';
+	span.start = chrono::duration_cast<chrono::nanoseconds>(start - origin).count();
+	span.duration = chrono::duration_cast<chrono::nanoseconds>(end - start).count();
+	span.thread = threadIndex();
+
+	bool halfFull;
+	{
+		lock_guard<std::mutex> lock(mutex);
+
+		// the capture may have stopped after the caller checked
+		if (ring.empty()) {
+			return;
+		}
+
+		if (count == CAPACITY) {
+			droppedSpans++;
+			return;
+		}
+
+		ring[(head + count) % CAPACITY] = span;
+		count++;
+
+		halfFull = count == CAPACITY / 2;
+	}
+
+	// don't wait for the timer if the ring is filling up
+	if (halfFull) {
+		wake.notify_one();
+	}
+}
+
+long long TraceRecorder::getDroppedSpans() {
+	lock_guard<std::mutex> lock(mutex);
+	return droppedSpans;
+}
+
+void TraceRecorder::writerLoop() {
+	vector<Span> spans;
+	spans.reserve(CAPACITY);
+
+	while (true) {
+		bool finished;
+		{
+			unique_lock<std::mutex> lock(mutex);
+			wake.wait_for(lock, FLUSH_INTERVAL, [this] { return stopping || count >= CAPACITY / 2; });
+
+			// copy out under the lock and format outside it so recording threads are only held up for the copy
+			spans.clear();
+			for (int i = 0; i < count; i++) {
+				spans.push_back(ring[(head + i) % CAPACITY]);
+			}
+			head = (head + count) % CAPACITY;
+			count = 0;
+
+			finished = stopping;
+		}
+
+		writeSpans(spans);
+
+		if (finished) {
+			file.flush();
+			return;
+		}
+	}
+}
+
+void TraceRecorder::writeSpans(vector<Span> &spans) {
+	char buffer[256];
+
+	for (int i = 0; i < spans.size(); i++) {
+		Span &span = spans[i];
+
+		// complete events, times are in microseconds
+		snprintf(buffer, sizeof(buffer), "{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f}",
+			span.name, span.thread, span.start / 1000.0, span.duration / 1000.0);
+
+		writeEvent(buffer);
+	}
+}
+
+void TraceRecorder::writeEvent(string event) {
+	if (!firstEvent) {
+		file << ",\n";
+	}
+	file << event;
+	firstEvent = false;
+}
+
+// small stable id for the calling thread, the viewer shows one row per id
+int TraceRecorder::threadIndex() {
+	static atomic<int> nextIndex(1);
+	thread_local int index = nextIndex.fetch_add(1);
+	return index;
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Writes spans of time (frames, solver phases, render passes) to a file in the Chrome trace-event json format
+// so a capture can be opened in chrome://tracing or Perfetto.
+// Spans go into a fixed size ring and a background thread drains it to the file, so recording never waits on disk.
+// If the ring fills up faster than it is written the newest spans are dropped and counted.
+// When nothing is being recorded a span costs one atomic load.
+class TraceRecorder {
+public:
+	static const int CAPACITY = 1 << 16;
+
+	TraceRecorder();
+	~TraceRecorder();
+
+	// starts a new capture in path (stopping the current one first), returns false if the file can't be opened
+	bool start(std::string path);
+
+	// flushes what is left, closes the json and the file
+	void stop();
+
+	bool isRecording() {
+		return recording.load(std::memory_order_relaxed);
+	}
+
+	// shows up as the name of the calling thread's row in the viewer
+	void setThreadName(std::string name);
+
+	void addSpan(const char* name, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end);
+
+	// spans lost to a full ring in the current (or last) capture
+	long long getDroppedSpans();
+
+private:
+	struct Span {
+		char name[48];
+		long long start;
+		long long duration;
+		int thread;
+	};
+
+	std::atomic<bool> recording;
+
+	std::mutex mutex;
+	std::condition_variable wake;
+
+	std::vector<Span> ring;
+	int head;
+	int count;
+	long long droppedSpans;
+
+	std::map<int, std::string> threadNames;
+
+	std::chrono::steady_clock::time_point origin;
+
+	std::ofstream file;
+	bool firstEvent;
+
+	std::thread writer;
+	bool stopping;
+
+	void writerLoop();
+	void writeSpans(std::vector<Span> &spans);
+	void writeEvent(std::string event);
+
+	static int threadIndex();
+};
+
+// the recorder every part of the program traces into
+extern TraceRecorder traceRecorder;
+
+// records the scope it lives in as one span while a capture is running
+// name has to outlive the scope (normally a string literal)
+class TraceScope {
+public:
+	TraceScope(const char* name) : name(name) {
+		active = traceRecorder.isRecording();
+		if (active) {
+			start = std::chrono::steady_clock::now();
+		}
+	}
+
+	~TraceScope() {
+		if (active) {
+			traceRecorder.addSpan(name, start, std::chrono::steady_clock::now());
+		}
+	}
+
+private:
+	const char* name;
+	bool active;
+	std::chrono::steady_clock::time_point start;
+};
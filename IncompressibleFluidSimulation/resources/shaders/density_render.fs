@@ -0,0 +1,17 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+// rgb density of the latest sim step and the one before it
+uniform sampler2D current;
+uniform sampler2D previous;
+
+// 0 draws the previous sim step, 1 the latest
+uniform float alpha = 1.0;
+
+void main()
+{
+    // clamped here so every render target format shows (and blurs) the same range the window can
+    FragColor = vec4(clamp(mix(texture(previous, TexCoords).rgb, texture(current, TexCoords).rgb, alpha), 0.0, 1.0), 1.0);
+}
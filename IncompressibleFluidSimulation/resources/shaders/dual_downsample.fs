@@ -0,0 +1,25 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D tex;
+
+//half a texel of the level being written, which is one texel of the level being read
+uniform vec2 halfPixel;
+//how far out the corner taps reach
+uniform float offset;
+
+void main()
+{
+    //the centre counts four times and each bilinear corner tap averages a 2x2 block around it
+    vec2 reach = halfPixel * offset;
+
+    vec3 sum = texture(tex, TexCoords).rgb * 4.0;
+    sum += texture(tex, TexCoords - reach).rgb;
+    sum += texture(tex, TexCoords + reach).rgb;
+    sum += texture(tex, TexCoords + vec2(reach.x, -reach.y)).rgb;
+    sum += texture(tex, TexCoords - vec2(reach.x, -reach.y)).rgb;
+
+    FragColor = vec4(sum / 8.0, 1.0);
+}
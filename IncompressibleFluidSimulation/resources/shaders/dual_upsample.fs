@@ -0,0 +1,28 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D tex;
+
+//half a texel of the level being written
+uniform vec2 halfPixel;
+//how far out the taps reach
+uniform float offset;
+
+void main()
+{
+    //a ring of eight taps, the diagonals weigh twice the straight ones
+    vec2 reach = halfPixel * offset;
+
+    vec3 sum = texture(tex, TexCoords + vec2(-reach.x * 2.0, 0.0)).rgb;
+    sum += texture(tex, TexCoords + vec2(reach.x * 2.0, 0.0)).rgb;
+    sum += texture(tex, TexCoords + vec2(0.0, -reach.y * 2.0)).rgb;
+    sum += texture(tex, TexCoords + vec2(0.0, reach.y * 2.0)).rgb;
+    sum += texture(tex, TexCoords + vec2(-reach.x, reach.y)).rgb * 2.0;
+    sum += texture(tex, TexCoords + vec2(reach.x, reach.y)).rgb * 2.0;
+    sum += texture(tex, TexCoords + vec2(reach.x, -reach.y)).rgb * 2.0;
+    sum += texture(tex, TexCoords + vec2(-reach.x, -reach.y)).rgb * 2.0;
+
+    FragColor = vec4(sum / 12.0, 1.0);
+}
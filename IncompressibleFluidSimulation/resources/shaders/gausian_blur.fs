@@ -2,25 +2,30 @@
 
 out vec4 FragColor;
 
-in vec2 blurTexCoords[11];
-//in vec2 TexCoords;
-flat in int Stage;
+in vec2 TexCoords;
+
+//BlurGL::MAX_TAP_PAIRS plus the centre
+const int MAX_TAPS = 17;
 
 uniform sampler2D tex;
 
+//one texel along the axis this pass blurs, x first then y
+uniform vec2 texelStep;
+
+//the centre tap and then one tap per pair of texels on each side, computed in BlurGL::setKernel
+//each offset sits between the two texels of its pair so the linear filter hands back their weighted sum in one fetch
+uniform int tapCount;
+uniform float tapOffsets[MAX_TAPS];
+uniform float tapWeights[MAX_TAPS];
+
 void main()
-{   
-	//output the color and sample from all the surrounding textures
-	FragColor = vec4(vec3(0.0), 1.0);
-
-	//11x11 blur 2 pass style
-	//weights for averaging so that the end result is a blur and not a block look on wiki im too tired to explain it is called kernel distribution in gaussian blurring or something
-	//http://dev.theomader.com/gaussian-kernel-calculator/
-	float[11] kernel = float[11](0.000003, 0.000229, 0.005977, 0.060598, 0.24173, 0.382925, 0.24173, 0.060598, 0.005977, 0.000229, 0.000003);
-
-	//add the value scaled down based on the number of extra samples we are drawing from
-	//if you were wondering i access the r value since it is the first value of the vec4 and I am inputing a single value float map into is so only r in rbg is nonzero
-	for (int i = 0; i < 11; i++){
-		FragColor += vec4(vec3(texture(tex, blurTexCoords[i]) * kernel[i]), 0.0);
+{
+	vec3 sum = texture(tex, TexCoords).rgb * tapWeights[0];
+
+	for (int i = 1; i < tapCount; i++){
+		vec2 offset = texelStep * tapOffsets[i];
+		sum += (texture(tex, TexCoords - offset).rgb + texture(tex, TexCoords + offset).rgb) * tapWeights[i];
 	}
-}  
\ No newline at end of file
+
+	FragColor = vec4(sum, 1.0);
+}
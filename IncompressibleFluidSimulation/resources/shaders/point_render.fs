@@ -1,9 +0,0 @@
-#version 330 core
-out vec4 FragColor;
-
-in vec3 fColor;
-
-void main()
-{
-    FragColor = vec4(fColor, 1.0);
-}
\ No newline at end of file
@@ -0,0 +1,79 @@
+# Runs a FluidSimHeadless script and checks that the files it writes agree, used by the tests in CMakeLists.txt.
+#
+#   HEADLESS     the FluidSimHeadless executable
+#   SCRIPT       script to run, @SIMD@, @PRESSURE@ and @SOLVER@ in it are filled in before it runs
+#   WORK_DIR     each run gets its own directory under here and the script's relative paths land in it
+#   SIMD_LEVELS  runs the script once per level (default one run with the best level the cpu has)
+#   PRESSURE     pressure backend (default relax)
+#   SOLVER       relaxation order (default gs)
+#   SAME_FILES   "a=b" pairs of files one run writes that have to be byte for byte the same
+#   OUTPUTS      files every run writes that have to be byte for byte the same as the first run's
+#
+# a level the cpu doesn't support falls back to a lower one in the sim, it's reported and left out of the comparison
+
+cmake_minimum_required(VERSION 3.10)
+
+if(NOT SIMD_LEVELS)
+	set(SIMD_LEVELS native)
+endif()
+if(NOT PRESSURE)
+	set(PRESSURE relax)
+endif()
+if(NOT SOLVER)
+	set(SOLVER gs)
+endif()
+
+file(READ ${SCRIPT} template)
+
+set(compared)
+foreach(level ${SIMD_LEVELS})
+	set(dir ${WORK_DIR}/${level})
+	file(REMOVE_RECURSE ${dir})
+	file(MAKE_DIRECTORY ${dir})
+
+	set(script "${template}")
+	string(REPLACE "@SIMD@" ${level} script "${script}")
+	string(REPLACE "@PRESSURE@" ${PRESSURE} script "${script}")
+	string(REPLACE "@SOLVER@" ${SOLVER} script "${script}")
+	file(WRITE ${dir}/script.txt "${script}")
+
+	execute_process(
+		COMMAND ${HEADLESS} script.txt
+		WORKING_DIRECTORY ${dir}
+		RESULT_VARIABLE result
+		OUTPUT_VARIABLE output
+		ERROR_VARIABLE output
+	)
+	if(NOT result EQUAL 0)
+		message(FATAL_ERROR "${SCRIPT} failed at simd ${level}:\n${output}")
+	endif()
+
+	foreach(pair ${SAME_FILES})
+		string(REPLACE "=" ";" files ${pair})
+		list(GET files 0 first)
+		list(GET files 1 second)
+		execute_process(COMMAND ${CMAKE_COMMAND} -E compare_files ${dir}/${first} ${dir}/${second} RESULT_VARIABLE different)
+		if(different)
+			message(FATAL_ERROR "${first} and ${second} differ at simd ${level}")
+		endif()
+	endforeach()
+
+	if(output MATCHES "only supports")
+		message(STATUS "simd ${level} isn't supported here, not compared")
+	else()
+		list(APPEND compared ${level})
+	endif()
+endforeach()
+
+list(LENGTH compared count)
+if(count GREATER 1)
+	list(GET compared 0 reference)
+	foreach(level ${compared})
+		foreach(output ${OUTPUTS})
+			execute_process(COMMAND ${CMAKE_COMMAND} -E compare_files ${WORK_DIR}/${reference}/${output} ${WORK_DIR}/${level}/${output} RESULT_VARIABLE different)
+			if(different)
+				message(FATAL_ERROR "${output} differs between simd ${reference} and ${level}")
+			endif()
+		endforeach()
+	endforeach()
+endif()